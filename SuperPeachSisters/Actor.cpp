@@ -1,11 +1,17 @@
 #include "Actor.h"
 #include "StudentWorld.h"
+#include "Random.h"
 #include <cmath>
+#include <cstring>
 
-Actor::Actor(StudentWorld* world, int imageID, int startX, int startY, int dir, int depth, double size) : GraphObject(imageID, startX, startY, dir, depth, size)
+Actor::Actor(StudentWorld* world, int imageID, int startX, int startY, int dir, int depth, double size) : GraphObject(world->graphObjects(), imageID, startX, startY, dir, depth, size)
 {
 	m_studentWorld = world;
 	m_isAlive = true; // All Actors start out alive
+	m_extraState = 0;
+	m_gridSlot = -1;
+	m_actorIndex = -1;
+	m_stateHash = 0; // Not part of the world's hash until StudentWorld adds the Actor 
 }
 
 // The purpose of defining the < operator in this way is to ensure that all Actors that are limited to moving only horizontally (and therefore not moving vertically)
@@ -28,6 +34,42 @@ bool Actor::operator<(const Actor& other) const
 		return false;
 }
 
+void Actor::moveTo(double x, double y)
+{
+	double oldX = getX();
+	double oldY = getY();
+	GraphObject::moveTo(x, y);
+	m_studentWorld->actorMoved(this, oldX, oldY);
+	updateStateHash();
+}
+
+void Actor::setDirection(int d)
+{
+	GraphObject::setDirection(d);
+	updateStateHash();
+}
+
+void Actor::updateStateHash()
+{
+	uint64_t old = m_stateHash;
+	m_stateHash = computeStateHash();
+	m_studentWorld->actorChanged(this, m_stateHash - old);
+}
+
+// This runs every time an Actor moves, so the small fields are packed into one word and the whole state takes just two rounds of mixing; 
+// the position goes in a round after the rest so that x and y can't be swapped for each other without changing the hash 
+uint64_t Actor::computeStateHash() const
+{
+	double x = getX();
+	double y = getY();
+	uint64_t xBits, yBits;
+	memcpy(&xBits, &x, sizeof(xBits));
+	memcpy(&yBits, &y, sizeof(yBits));
+	uint64_t fields = static_cast<uint64_t>(getID()) | (alive() ? 1 : 0) << 8 | static_cast<uint64_t>(getDirection() & 0xFFFF) << 16 |
+		static_cast<uint64_t>(static_cast<uint32_t>(extraState())) << 32;
+	return Random::mix(Random::mix(yBits ^ fields) ^ xBits);
+}
+
 /*------------------------------------------------------------------------------------------------------------------------------*/
 
 Peach::Peach(StudentWorld* world, int startX, int startY) : Actor(world, IID_PEACH, startX, startY, 0)
@@ -39,6 +81,34 @@ Peach::Peach(StudentWorld* world, int startX, int startY) : Actor(world, IID_PEA
 	m_tempInvincibilityTicks = 0;
 }
 
+void Peach::getPowerState(PowerState& state) const
+{
+	state.remainingJumpDistance = m_remainingJumpDistance;
+	state.jumpPower = m_jumpPower;
+	state.shootPowerTicks = m_shootPowerTicks;
+	state.starPowerTicks = m_starPowerTicks;
+	state.tempInvincibilityTicks = m_tempInvincibilityTicks;
+}
+
+void Peach::setPowerState(const PowerState& state)
+{
+	m_remainingJumpDistance = state.remainingJumpDistance;
+	m_jumpPower = state.jumpPower != 0;
+	m_shootPowerTicks = state.shootPowerTicks;
+	m_starPowerTicks = state.starPowerTicks;
+	m_tempInvincibilityTicks = state.tempInvincibilityTicks;
+	updateStateHash();
+}
+
+uint64_t Peach::computeStateHash() const
+{
+	uint64_t jumping = static_cast<uint64_t>(static_cast<uint32_t>(m_remainingJumpDistance)) << 32 | (m_jumpPower ? 1 : 0);
+	uint64_t powers = static_cast<uint64_t>(static_cast<uint32_t>(m_shootPowerTicks)) << 32 | static_cast<uint32_t>(m_starPowerTicks);
+	uint64_t h = Random::mix(Actor::computeStateHash() ^ jumping);
+	h = Random::mix(h ^ powers);
+	return Random::mix(h ^ static_cast<uint32_t>(m_tempInvincibilityTicks));
+}
+
 void Peach::doSomething()
 {
 	if (!alive())
@@ -113,11 +183,12 @@ void Peach::doSomething()
 					x = getX() + 4;
 				else
 					x = getX() - 4;
-				getStudentWorld()->addActor(new PeachFireball(getStudentWorld(), x, getY(), getDirection())); // Spawn Fireball in direction 
+				getStudentWorld()->addActor<PeachFireball>(x, getY(), getDirection()); // Spawn Fireball in direction 
 			}
 			break;
 		}
 	}
+	updateStateHash(); // Peach's counters change throughout the tick, so her hash is brought up to date once at the end 
 }
 
 void Peach::bonk(const Actor& actor)
@@ -136,6 +207,7 @@ void Peach::bonk(const Actor& actor)
 		{
 			setDead();
 		}
+		updateStateHash();
 	}
 }
 
@@ -145,24 +217,25 @@ void Block::bonk(const Actor& actor)
 	// A Block can only get bonked if it by Peach 
 	if (actor.player())
 	{
-		if (m_containsGoodie == 0) // No Goodie in the block, so just play the sound 
+		if (extraState() == 0) // No Goodie in the block, so just play the sound 
 			getStudentWorld()->playSound(SOUND_PLAYER_BONK);
 		else // Goodie in the block 
 		{
 			getStudentWorld()->playSound(SOUND_POWERUP_APPEARS);
-			switch (m_containsGoodie)
+			switch (extraState())
 			{
 				case 1:
-					getStudentWorld()->addActor(new Mushroom(getStudentWorld(), getX(), getY() + 8));
+					getStudentWorld()->addActor<Mushroom>(getX(), getY() + 8);
 					break;
 				case 2:
-					getStudentWorld()->addActor(new Flower(getStudentWorld(), getX(), getY() + 8));
+					getStudentWorld()->addActor<Flower>(getX(), getY() + 8);
 					break;
 				case 3:
-					getStudentWorld()->addActor(new Star(getStudentWorld(), getX(), getY() + 8));
+					getStudentWorld()->addActor<Star>(getX(), getY() + 8);
 					break;
 			}
-			m_containsGoodie = 0;
+			setExtraState(0);
+			updateStateHash();
 		}
 	}
 }
@@ -328,7 +401,7 @@ void Enemy::bonk(const Actor& actor)
 /*------------------------------------------------------------------------------------------------------------------------------*/
 void Koopa::deathAction()
 {
-	getStudentWorld()->addActor(new Shell(getStudentWorld(), getX(), getY(), getDirection()));
+	getStudentWorld()->addActor<Shell>(getX(), getY(), getDirection());
 }
 
 /*------------------------------------------------------------------------------------------------------------------------------*/
@@ -357,15 +430,17 @@ void Piranha::doSomething()
 		
 		if (firingDelay())
 		{
-			m_firingDelay--;
+			setExtraState(extraState() - 1);
+			updateStateHash();
 			return;
 		}
 
 		if (peachX != -1 && (SPRITE_WIDTH * 8 > abs(peachX - getX()))) // Check if Peach is within firing distance; if so, fire 
 		{
-			getStudentWorld()->addActor(new PiranhaFireball(getStudentWorld(), getX(), getY(), getDirection()));
+			getStudentWorld()->addActor<PiranhaFireball>(getX(), getY(), getDirection());
 			getStudentWorld()->playSound(SOUND_PIRANHA_FIRE);
-			m_firingDelay = 40;
+			setExtraState(40);
+			updateStateHash();
 		}
 	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define ACTOR_H_
 
 #include "GraphObject.h"
+#include <cstdint>
 
 class StudentWorld;
 
@@ -29,15 +30,47 @@ class Actor : public GraphObject
 		bool priority() const { return (projectile() || powerup()); }
 		
 		bool alive() const { return m_isAlive; }
+
+		// The one piece of state (if any) an Actor keeps beyond its position, direction and whether it is alive, i.e. a Block's goodie or a 
+		// Piranha's firing delay. It is kept here rather than in the derived class so that save states and hashing can read it without a 
+		// virtual call. Peach keeps more than one, so she has her own PowerState instead 
+		int extraState() const { return m_extraState; }
+		void setExtraState(int state) { m_extraState = state; }
+		void restoreAlive(bool alive) { m_isAlive = alive; } // Only for restoring a save state; Actors otherwise only ever die 
+
+		// World hashing: everything about an Actor hashes to one value, and its world's hash adds up those of all its Actors (wrapping 
+		// around, and unlike XOR, two Actors in exactly the same state don't cancel out). Whenever something hashed changes, 
+		// updateStateHash() adds the difference between the new value and the old to the world's hash, so the world's hash never has to be 
+		// recomputed from scratch. An Actor whose hash has never been updated (0) is not part of its world's hash yet 
+		uint64_t stateHash() const { return m_stateHash; }
+		void updateStateHash();
+		virtual uint64_t computeStateHash() const; // Hash the Actor's current state from scratch 
+
+		// Overriden so that StudentWorld can keep its spatial grid and hash in sync with the Actor's position and direction 
+		virtual void moveTo(double x, double y);
+		virtual void setDirection(int d);
+
+		// The Actor's index within its spatial grid cell, kept up to date by SpatialGrid; -1 while it is not in the grid (i.e. Peach) 
+		int gridSlot() const { return m_gridSlot; }
+		void setGridSlot(int slot) { m_gridSlot = slot; }
+
+		// The Actor's index in its world's m_actors, kept up to date by StudentWorld so that bonkAt() can order what it hits without 
+		// searching for it; -1 while it is not in m_actors (i.e. Peach) 
+		int actorIndex() const { return m_actorIndex; }
+		void setActorIndex(int index) { m_actorIndex = index; }
 	
 	protected:
 		// Methods only to be used within derived classes 
 		StudentWorld* getStudentWorld() const { return m_studentWorld; }
-		void setDead() { m_isAlive = false; }
+		void setDead() { m_isAlive = false; updateStateHash(); }
 	
 	private:
 		StudentWorld* m_studentWorld; // Access StudentWorld methods
 		bool m_isAlive;
+		int m_extraState;
+		int m_gridSlot;
+		int m_actorIndex;
+		uint64_t m_stateHash;
 };
 
 /*----------------------------------------------------------------------------------------------------------------------------*/
@@ -66,19 +99,33 @@ class Peach : public Actor
 		bool getShootPower() const { return m_shootPowerTicks != -1; } // Peach has Shoot Power if there are 0 or more ticks remaining to shoot 
 		bool getStarPower() const { return m_starPowerTicks != 0; } // Peach has Star Power if there are more than 0 ticks remaining 
 		
-		void giveJumpPower() { m_jumpPower = true; }
+		void giveJumpPower() { m_jumpPower = true; updateStateHash(); }
 		void giveShootPower() 
 		{
 			if (!getShootPower())
 				m_shootPowerTicks = 8;
+			updateStateHash();
 		}
 		void giveStarPower()
 		{
 			if (!getStarPower())
 				m_starPowerTicks = 150;
-		
+			updateStateHash();
 		}
 
+		// Everything Peach keeps track of between ticks, for save states 
+		struct PowerState
+		{
+			int32_t remainingJumpDistance;
+			int32_t jumpPower;
+			int32_t shootPowerTicks;
+			int32_t starPowerTicks;
+			int32_t tempInvincibilityTicks;
+		};
+		void getPowerState(PowerState& state) const;
+		void setPowerState(const PowerState& state);
+		virtual uint64_t computeStateHash() const;
+
 	private:
 		int m_remainingJumpDistance;
 		bool m_jumpPower;
@@ -106,11 +153,10 @@ class Terrain : public Actor
 class Block : public Terrain
 {
 	public:
-		Block(StudentWorld* world, int startX, int startY, int goodie) : Terrain(world, IID_BLOCK, startX, startY) { m_containsGoodie = goodie; }
+		// The goodie is the Block's extra state: 0 = No Goodie, 1 = Mushroom, 2 = Flower, 3 = Star 
+		Block(StudentWorld* world, int startX, int startY, int goodie) : Terrain(world, IID_BLOCK, startX, startY) { setExtraState(goodie); }
 		virtual void bonk(const Actor& actor);
-	
-	private:
-		int m_containsGoodie; // 0 = No Goodie, 1 = Mushroom, 2 = Flower, 3 = Star 
+		void setGoodie(int goodie) { setExtraState(goodie); updateStateHash(); } // Put a goodie (back) in the Block 
 };
 
 /*------------------------------------------------------------------------------------------------------------------------------*/
@@ -276,7 +322,8 @@ class Koopa : public Enemy
 class Piranha : public Enemy
 {
 	public:
-		Piranha(StudentWorld* world, int startX, int startY, int direction) : Enemy(world, IID_PIRANHA, startX, startY, direction) { m_firingDelay = 0; }
+		// The firing delay, in ticks, is the Piranha's extra state 
+		Piranha(StudentWorld* world, int startX, int startY, int direction) : Enemy(world, IID_PIRANHA, startX, startY, direction) {}
 		// Overriden doSomething() since unlike a Goomba and Koopa, a Piranha does not move but rather stays still and shoots 
 		virtual void doSomething();
 	
@@ -284,7 +331,6 @@ class Piranha : public Enemy
 		virtual void deathAction() {}
 
 	private:
-		int m_firingDelay;
-		bool firingDelay() { return (m_firingDelay > 0); }
+		bool firingDelay() { return (extraState() > 0); }
 };
 #endif // ACTOR_H_
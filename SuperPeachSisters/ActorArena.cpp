@@ -0,0 +1,12 @@
+#include "ActorArena.h"
+#include "Actor.h"
+
+void ActorArena::destroy(Actor* actor)
+{
+	// The slot header sits right before the most derived object, which is not necessarily where the Actor base subobject starts 
+	void* object = dynamic_cast<void*>(actor);
+	actor->~Actor();
+	SlotHeader* slot = slotOf(object);
+	slot->owner->release(slot);
+	m_liveObjects--;
+}
@@ -0,0 +1,141 @@
+#ifndef ACTORARENA_H_
+#define ACTORARENA_H_
+
+#include <vector>
+#include <tuple>
+#include <new>
+#include <cstddef>
+
+class Actor;
+class Peach;
+class Block;
+class Pipe;
+class Flag;
+class Mario;
+class Mushroom;
+class Flower;
+class Star;
+class PiranhaFireball;
+class PeachFireball;
+class Shell;
+class Goomba;
+class Koopa;
+class Piranha;
+
+// Per-world allocator for Actors. Every concrete Actor type gets its own pool of fixed-size slots carved out of larger slabs, and freed slots
+// go onto that type's free list to be handed straight back out by the next create(). Once the pools have grown to the peak number of live
+// Actors of each type, spawning and destroying Actors never touches the heap, which heapAllocations() can be used to confirm
+class ActorArena
+{
+	public:
+		ActorArena()
+		 : m_heapAllocations(0), m_liveObjects(0)
+		{
+		}
+
+		template <typename T, typename... Args>
+		T* create(Args... args)
+		{
+			SlabPool& pool = std::get<TypedPool<T>>(m_pools);
+			SlotHeader* slot = pool.allocate(sizeof(T), m_heapAllocations);
+			m_liveObjects++;
+			return new (objectOf(slot)) T(args...);
+		}
+
+		void destroy(Actor* actor);
+
+		// Number of slabs that have been requested from the heap over the arena's lifetime
+		size_t heapAllocations() const { return m_heapAllocations; }
+		size_t liveObjects() const { return m_liveObjects; }
+
+	private:
+		class SlabPool;
+
+		// Every slot starts with a header so that destroy() can find the pool an Actor came from without knowing its concrete type; the header
+		// is padded to max_align_t so the object that follows it is suitably aligned for any Actor
+		struct alignas(std::max_align_t) SlotHeader
+		{
+			SlabPool* owner;
+			SlotHeader* nextFree;
+		};
+
+		class SlabPool
+		{
+			public:
+				SlabPool()
+				 : m_freeList(nullptr), m_slotSize(0)
+				{
+				}
+
+				SlotHeader* allocate(size_t objectSize, size_t& heapAllocations)
+				{
+					if (m_freeList == nullptr)
+						grow(objectSize, heapAllocations);
+					SlotHeader* slot = m_freeList;
+					m_freeList = slot->nextFree;
+					return slot;
+				}
+
+				void release(SlotHeader* slot)
+				{
+					slot->nextFree = m_freeList;
+					m_freeList = slot;
+				}
+
+				// Any Actors still alive at this point are leaked on purpose (GameController reports them), only the slabs themselves are freed
+				~SlabPool()
+				{
+					for (size_t i = 0; i < m_slabs.size(); i++)
+						::operator delete(m_slabs[i]);
+				}
+
+			private:
+				static const size_t SLOTS_PER_SLAB = 64;
+
+				std::vector<void*> m_slabs;
+				SlotHeader* m_freeList;
+				size_t m_slotSize;
+
+				// Prevent copying or assigning a SlabPool
+				SlabPool(const SlabPool&);
+				SlabPool& operator=(const SlabPool&);
+
+				void grow(size_t objectSize, size_t& heapAllocations)
+				{
+					if (m_slotSize == 0) // Round each slot up so that the header of the following slot stays aligned
+						m_slotSize = sizeof(SlotHeader) + (objectSize + alignof(SlotHeader) - 1) / alignof(SlotHeader) * alignof(SlotHeader);
+					unsigned char* slab = static_cast<unsigned char*>(::operator new(m_slotSize * SLOTS_PER_SLAB));
+					m_slabs.push_back(slab);
+					heapAllocations++;
+					for (size_t i = SLOTS_PER_SLAB; i > 0; i--) // Push in reverse so slots are handed out in address order
+					{
+						SlotHeader* slot = reinterpret_cast<SlotHeader*>(slab + (i - 1) * m_slotSize);
+						slot->owner = this;
+						release(slot);
+					}
+				}
+		};
+
+		// Distinct pool type per Actor type, purely so that std::get can look a pool up by type at compile time
+		template <typename T>
+		class TypedPool : public SlabPool
+		{
+		};
+
+		typedef std::tuple<TypedPool<Peach>, TypedPool<Block>, TypedPool<Pipe>, TypedPool<Flag>, TypedPool<Mario>, TypedPool<Mushroom>,
+			TypedPool<Flower>, TypedPool<Star>, TypedPool<PiranhaFireball>, TypedPool<PeachFireball>, TypedPool<Shell>, TypedPool<Goomba>,
+			TypedPool<Koopa>, TypedPool<Piranha>> PoolTuple;
+
+		PoolTuple m_pools;
+		size_t m_heapAllocations;
+		size_t m_liveObjects;
+
+		static void* objectOf(SlotHeader* slot) { return slot + 1; }
+		static SlotHeader* slotOf(void* object) { return static_cast<SlotHeader*>(object) - 1; }
+
+		// Prevent copying or assigning an ActorArena
+		ActorArena(const ActorArena&);
+		ActorArena& operator=(const ActorArena&);
+};
+
+#endif // ACTORARENA_H_
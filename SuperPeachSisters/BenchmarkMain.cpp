@@ -0,0 +1,405 @@
+#include "StudentWorld.h"
+#include "HeadlessHost.h"
+#include "InputScript.h"
+#include "GameConstants.h"
+#include "LevelGenerator.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <cstdlib>
+using namespace std;
+
+  // Measures how StudentWorld::move() scales:
+  //
+  //   SuperPeachBench [--assets dir] [--level-file path]... [--generate n] [--gen-dir dir] [--ticks n] [--input-seed n]
+  //                  [--input script] [--out results.json]
+  //
+  // Each level (the shipped level01..03.txt unless --level-file or --generate is given) is loaded into a headless world and run for the given
+  // number of ticks with scripted input for Peach, which is generated from --input-seed unless a text script or a recorded session is given
+  // with --input (a recording also supplies the world's seed). --generate writes n generated levels of increasing enemy density into
+  // --gen-dir (build by default) and benchmarks those too. Whenever Peach dies or reaches a goal the same level is reloaded, so every tick
+  // is measured against the level's own actor mix. Tick latencies are split both by the number of Actors at the start of each tick and by
+  // the mix of enemies and projectiles at that moment, which is counted afresh every tick as Actors die and spawn. Each level is then
+  // branched from where its run ended, the way a search tool would: a second world is cloned from it over and over and run a few ticks
+  // each time. Results are written as JSON.
+
+typedef chrono::steady_clock Clock;
+
+static const int BRANCHES = 1000;
+static const int TICKS_PER_BRANCH = 10;
+
+static const int NUM_MIX_KINDS = 4;
+static const char* const MIX_KINDS[NUM_MIX_KINDS] = { "goombas", "koopas", "piranhas", "projectiles" };
+
+// What one tick started with, and how long it took
+struct TickSample
+{
+	int		actors;
+	int		mix[NUM_MIX_KINDS];	// in MIX_KINDS order
+	double	us;
+};
+
+struct LatencySummary
+{
+	long   ticks;
+	double p50Us;
+	double p99Us;
+	double maxUs;
+};
+
+struct LevelResult
+{
+	string			levelFile;
+	bool			loaded;
+	long			ticks;
+	long			reloads;
+	double			loadUs;				// the first init() only
+	double			totalTickUs;
+	double			branchUs;			// to clone the world and run TICKS_PER_BRANCH ticks, averaged over BRANCHES branches
+	LatencySummary	overall;
+	vector<int>		initialCounts;		// by image ID
+	int				peakActors;
+	int				peakProjectiles;
+	vector<pair<int, LatencySummary>> byActorCount;	// keyed by the lower bound of a power-of-two bucket
+	vector<vector<double>> meanMixByActorCount;		// the average mix over each byActorCount bucket's ticks, in MIX_KINDS order
+	vector<pair<vector<int>, LatencySummary>> byMix;	// keyed by the lower bound of each kind's bucket (0, or a power of two)
+};
+
+static void usage()
+{
+	cerr << "usage: SuperPeachBench [--assets dir] [--level-file path]... [--generate n] [--gen-dir dir] [--ticks n] [--input-seed n]" << endl
+		 << "                       [--input script] [--out results.json]" << endl;
+}
+
+static LatencySummary summarize(vector<double>& latenciesUs)
+{
+	LatencySummary s = { static_cast<long>(latenciesUs.size()), 0, 0, 0 };
+	if (latenciesUs.empty())
+		return s;
+	sort(latenciesUs.begin(), latenciesUs.end());
+	size_t n = latenciesUs.size();
+	s.p50Us = latenciesUs[(n - 1) / 2];
+	s.p99Us = latenciesUs[min(n - 1, static_cast<size_t>(n * 0.99))];
+	s.maxUs = latenciesUs[n - 1];
+	return s;
+}
+
+static int bucketFor(int actors)
+{
+	int bucket = 1;
+	while (bucket * 2 <= actors)
+		bucket *= 2;
+	return bucket;
+}
+
+// Like bucketFor(), but with none at all kept apart, since a level without any of some kind of enemy is common
+static int mixBucketFor(int count)
+{
+	return count == 0 ? 0 : bucketFor(count);
+}
+
+static int mixBucketEnd(int bucket)
+{
+	return bucket == 0 ? 0 : bucket * 2 - 1;
+}
+
+static bool fewerActors(const TickSample& a, const TickSample& b)
+{
+	return a.actors < b.actors;
+}
+
+static vector<int> mixKey(const TickSample& s)
+{
+	vector<int> key(NUM_MIX_KINDS);
+	for (int k = 0; k < NUM_MIX_KINDS; k++)
+		key[k] = mixBucketFor(s.mix[k]);
+	return key;
+}
+
+static double elapsedUs(Clock::time_point start, Clock::time_point end)
+{
+	return chrono::duration<double, micro>(end - start).count();
+}
+
+static LevelResult runLevel(string assetPath, string levelFile, long ticks, const InputScript& input)
+{
+	LevelResult result;
+	result.levelFile = levelFile;
+	result.ticks = 0;
+	result.reloads = 0;
+	result.totalTickUs = 0;
+	result.branchUs = 0;
+	result.peakActors = 0;
+	result.peakProjectiles = 0;
+
+	StudentWorld world(assetPath);
+	world.setLevelFile(levelFile);
+	world.setSeed(input.seed());
+	HeadlessHost host(&input);
+	host.attach(&world);
+
+	Clock::time_point start = Clock::now();
+	int status = world.init();
+	result.loadUs = elapsedUs(start, Clock::now());
+	result.loaded = (status != GWSTATUS_LEVEL_ERROR);
+	if (!result.loaded)
+		return result;
+	world.countActorsByImage(result.initialCounts);
+
+	vector<double> latencies;
+	latencies.reserve(ticks);
+	vector<TickSample> samples;
+	samples.reserve(ticks);
+	vector<int> counts;
+
+	for (long t = 0; t < ticks; t++)
+	{
+		world.countActorsByImage(counts);
+		int actors = world.numActors();
+		int projectiles = counts[IID_SHELL] + counts[IID_PIRANHA_FIRE] + counts[IID_PEACH_FIRE];
+		result.peakActors = max(result.peakActors, actors);
+		result.peakProjectiles = max(result.peakProjectiles, projectiles);
+		TickSample sample = { actors, { counts[IID_GOOMBA], counts[IID_KOOPA], counts[IID_PIRANHA], projectiles }, 0 };
+
+		start = Clock::now();
+		status = world.tick();
+		sample.us = elapsedUs(start, Clock::now());
+		latencies.push_back(sample.us);
+		samples.push_back(sample);
+		result.totalTickUs += sample.us;
+
+		if (status != GWSTATUS_CONTINUE_GAME)
+		{
+			world.restartLevel();
+			result.reloads++;
+		}
+	}
+	result.ticks = ticks;
+	result.overall = summarize(latencies);
+
+	StudentWorld branch(assetPath);
+	HeadlessHost branchHost(&input);
+	branchHost.attach(&branch);
+	start = Clock::now();
+	for (int b = 0; b < BRANCHES; b++)
+	{
+		branch.cloneFrom(world);
+		for (int t = 0; t < TICKS_PER_BRANCH; t++)
+			if (branch.tick() != GWSTATUS_CONTINUE_GAME)
+				break;
+	}
+	result.branchUs = elapsedUs(start, Clock::now()) / BRANCHES;
+
+	map<vector<int>, vector<double>> byMix;
+	for (size_t i = 0; i < samples.size(); i++)
+		byMix[mixKey(samples[i])].push_back(samples[i].us);
+	for (map<vector<int>, vector<double>>::iterator it = byMix.begin(); it != byMix.end(); ++it)
+		result.byMix.push_back(make_pair(it->first, summarize(it->second)));
+
+	sort(samples.begin(), samples.end(), fewerActors);
+	for (size_t i = 0; i < samples.size(); )
+	{
+		int bucket = bucketFor(samples[i].actors);
+		vector<double> bucketLatencies;
+		vector<double> meanMix(NUM_MIX_KINDS, 0);
+		for (; i < samples.size() && bucketFor(samples[i].actors) == bucket; i++)
+		{
+			bucketLatencies.push_back(samples[i].us);
+			for (int k = 0; k < NUM_MIX_KINDS; k++)
+				meanMix[k] += samples[i].mix[k];
+		}
+		for (int k = 0; k < NUM_MIX_KINDS; k++)
+			meanMix[k] /= bucketLatencies.size();
+		result.byActorCount.push_back(make_pair(bucket, summarize(bucketLatencies)));
+		result.meanMixByActorCount.push_back(meanMix);
+	}
+	return result;
+}
+
+static string jsonString(string s)
+{
+	string out = "\"";
+	for (size_t k = 0; k < s.size(); k++)
+	{
+		if (s[k] == '"' || s[k] == '\\')
+			out += '\\';
+		out += s[k];
+	}
+	return out + "\"";
+}
+
+static void writeLatency(ostream& out, const LatencySummary& s)
+{
+	out << "\"ticks\": " << s.ticks << ", \"p50_us\": " << s.p50Us << ", \"p99_us\": " << s.p99Us << ", \"max_us\": " << s.maxUs;
+}
+
+static void writeJson(ostream& out, const vector<LevelResult>& results, long ticks, unsigned long long seed)
+{
+	static const struct { const char* name; int imageID; } mix[] = {
+		{ "goomba", IID_GOOMBA }, { "koopa", IID_KOOPA }, { "piranha", IID_PIRANHA }, { "block", IID_BLOCK }, { "pipe", IID_PIPE },
+		{ "flag", IID_FLAG }, { "mario", IID_MARIO }, { "shell", IID_SHELL }, { "piranha_fire", IID_PIRANHA_FIRE },
+		{ "peach_fire", IID_PEACH_FIRE }, { "mushroom", IID_MUSHROOM }, { "flower", IID_FLOWER }, { "star", IID_STAR },
+	};
+
+	out << fixed << setprecision(3);
+	out << "{\n  \"ticks_per_level\": " << ticks << ",\n  \"input_seed\": " << seed << ",\n  \"levels\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const LevelResult& r = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "    {\n      \"level\": " << jsonString(r.levelFile) << ",\n";
+		if (!r.loaded)
+		{
+			out << "      \"error\": \"level failed to load\"\n    }";
+			continue;
+		}
+		int total = 0;
+		for (size_t k = 0; k < r.initialCounts.size(); k++)
+			total += r.initialCounts[k];
+		out << "      \"load_us\": " << r.loadUs << ",\n";
+		out << "      \"reloads\": " << r.reloads << ",\n";
+		out << "      \"ticks_per_sec\": " << (r.totalTickUs > 0 ? r.ticks * 1e6 / r.totalTickUs : 0) << ",\n";
+		out << "      \"branches_per_sec\": " << (r.branchUs > 0 ? 1e6 / r.branchUs : 0) << ",\n";
+		out << "      \"latency\": { ";
+		writeLatency(out, r.overall);
+		out << " },\n";
+		out << "      \"initial_actors\": { \"total\": " << total;
+		for (size_t k = 0; k < sizeof(mix) / sizeof(mix[0]); k++)
+			out << ", " << jsonString(mix[k].name) << ": " << r.initialCounts[mix[k].imageID];
+		out << " },\n";
+		out << "      \"peak_actors\": " << r.peakActors << ",\n";
+		out << "      \"peak_projectiles\": " << r.peakProjectiles << ",\n";
+		out << "      \"by_actor_count\": [";
+		for (size_t k = 0; k < r.byActorCount.size(); k++)
+		{
+			out << (k == 0 ? "\n" : ",\n") << "        { \"min_actors\": " << r.byActorCount[k].first
+				<< ", \"max_actors\": " << r.byActorCount[k].first * 2 - 1 << ", ";
+			writeLatency(out, r.byActorCount[k].second);
+			out << ", \"mean_mix\": { ";
+			for (int m = 0; m < NUM_MIX_KINDS; m++)
+				out << (m == 0 ? "" : ", ") << jsonString(MIX_KINDS[m]) << ": " << r.meanMixByActorCount[k][m];
+			out << " } }";
+		}
+		out << "\n      ],\n";
+		out << "      \"by_mix\": [";
+		for (size_t k = 0; k < r.byMix.size(); k++)
+		{
+			out << (k == 0 ? "\n" : ",\n") << "        { ";
+			for (int m = 0; m < NUM_MIX_KINDS; m++)
+				out << jsonString(MIX_KINDS[m]) << ": [" << r.byMix[k].first[m] << ", " << mixBucketEnd(r.byMix[k].first[m]) << "], ";
+			writeLatency(out, r.byMix[k].second);
+			out << " }";
+		}
+		out << "\n      ]\n    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	string assetPath = "Assets";
+	vector<string> levelFiles;
+	long ticks = 5000;
+	unsigned long long seed = 1;
+	string outFile;
+	string inputFile;
+	int numGenerated = 0;
+	string genDir = "build";
+
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (k + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+		if (arg == "--assets")
+			assetPath = argv[++k];
+		else if (arg == "--level-file")
+			levelFiles.push_back(argv[++k]);
+		else if (arg == "--generate")
+			numGenerated = atoi(argv[++k]);
+		else if (arg == "--gen-dir")
+			genDir = argv[++k];
+		else if (arg == "--ticks")
+			ticks = atol(argv[++k]);
+		else if (arg == "--input-seed")
+			seed = strtoull(argv[++k], nullptr, 10);
+		else if (arg == "--input")
+			inputFile = argv[++k];
+		else if (arg == "--out")
+			outFile = argv[++k];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	for (int n = 1; n <= numGenerated; n++)
+	{
+		LevelGenerator::Params params;
+		params.seed = n;
+		params.goombaDensity = params.koopaDensity = 0.04 * n;
+		params.piranhaDensity = 0.01 * n;
+		ostringstream oss;
+		oss << genDir << "/generated" << setfill('0') << setw(2) << n << ".txt";
+		if (!LevelGenerator::write(params, oss.str()))
+		{
+			cerr << "Cannot write " << oss.str() << endl;
+			return 1;
+		}
+		levelFiles.push_back(oss.str());
+	}
+
+	vector<pair<string, string>> levels; // (asset path, file name)
+	if (levelFiles.empty())
+	{
+		for (int n = 1; n <= 3; n++)
+		{
+			ostringstream oss;
+			oss << "level" << setfill('0') << setw(2) << n << ".txt";
+			levels.push_back(make_pair(assetPath, oss.str()));
+		}
+	}
+	for (size_t k = 0; k < levelFiles.size(); k++) // Level files given on the command line are taken as paths, not relative to the assets
+	{
+		string::size_type slash = levelFiles[k].find_last_of("/\\");
+		if (slash == string::npos)
+			levels.push_back(make_pair(string("."), levelFiles[k]));
+		else
+			levels.push_back(make_pair(levelFiles[k].substr(0, slash), levelFiles[k].substr(slash + 1)));
+	}
+
+	InputScript input;
+	if (inputFile.empty())
+		input = InputScript::makeWandering(seed, ticks);
+	else if (!input.load(inputFile))
+	{
+		cerr << "Cannot read input script " << inputFile << endl;
+		return 1;
+	}
+	vector<LevelResult> results;
+	for (size_t k = 0; k < levels.size(); k++)
+		results.push_back(runLevel(levels[k].first, levels[k].second, ticks, input));
+
+	if (outFile.empty())
+		writeJson(cout, results, ticks, seed);
+	else
+	{
+		ofstream out(outFile);
+		if (!out)
+		{
+			cerr << "Cannot write " << outFile << endl;
+			return 1;
+		}
+		writeJson(out, results, ticks, seed);
+	}
+	return 0;
+}
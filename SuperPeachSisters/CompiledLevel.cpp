@@ -0,0 +1,486 @@
+#include "CompiledLevel.h"
+#include "TerrainMap.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+  // The file starts with this header; each table follows at an offset that is a multiple of 8 from the start of the file. Everything is
+  // in the byte order of the machine that compiled the level, which byteOrder lets a loader check
+struct CompiledLevel::Header
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	byteOrder;
+	uint32_t	gridWidth;
+	uint32_t	gridHeight;
+	uint32_t	numSpawns;
+	uint32_t	numSpans;
+	uint32_t	numTerrainWords;
+	uint64_t	sourceSize;		// Of the text file this was compiled from
+	uint64_t	sourceHash;		// Its contents' FNV-1a hash
+	uint64_t	gridOffset;		// GRID_WIDTH * GRID_HEIGHT GridEntry bytes, row by row from the bottom
+	uint64_t	spawnsOffset;
+	uint64_t	spansOffset;
+	uint64_t	terrainOffset;	// A TerrainMap's words()
+};
+
+static const char MAGIC[4] = { 'S', 'P', 'L', 'B' };
+static const uint32_t VERSION = 2;	// 1 recorded the text file's modification time instead of a hash
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  // A file mapped read-only into memory
+class CompiledLevel::MappedFile
+{
+public:
+	MappedFile()
+	 : m_data(nullptr), m_size(0)
+	{
+#if defined(_WIN32)
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+#endif
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	bool open(const string& path);
+	void close();
+
+	const void* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	void*	m_data;
+	size_t	m_size;
+#if defined(_WIN32)
+	HANDLE	m_file;
+	HANDLE	m_mapping;
+#endif
+};
+
+#if defined(_WIN32)
+
+bool CompiledLevel::MappedFile::open(const string& path)
+{
+	close();
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void CompiledLevel::MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+static bool directoryWritable(const string& dir)
+{
+	DWORD attributes = GetFileAttributesA(dir.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) && !(attributes & FILE_ATTRIBUTE_READONLY);
+}
+
+static bool makeDirectory(const string& dir)
+{
+	return CreateDirectoryA(dir.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static string userCacheDirectory()
+{
+	const char* local = getenv("LOCALAPPDATA");
+	return local != nullptr && *local != '\0' ? local : "";
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static int processID()
+{
+	return _getpid();
+}
+
+#else
+
+bool CompiledLevel::MappedFile::open(const string& path)
+{
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			m_data = data;
+			m_size = st.st_size;
+		}
+	}
+	::close(fd);  // the mapping stays valid without the descriptor
+	return m_data != nullptr;
+}
+
+void CompiledLevel::MappedFile::close()
+{
+	if (m_data != nullptr)
+		munmap(m_data, m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+
+static bool directoryWritable(const string& dir)
+{
+	return access(dir.c_str(), W_OK) == 0;
+}
+
+static bool makeDirectory(const string& dir)
+{
+	return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+static string userCacheDirectory()
+{
+	const char* xdg = getenv("XDG_CACHE_HOME");
+	if (xdg != nullptr && *xdg != '\0')
+		return xdg;
+	const char* home = getenv("HOME");
+	if (home == nullptr || *home == '\0')
+		return "";
+	makeDirectory(string(home) + "/.cache");
+	return string(home) + "/.cache";
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+	return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static int processID()
+{
+	return getpid();
+}
+
+#endif
+
+static uint64_t fnv1a(const char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+  // The text file's size and a hash of its contents, which is what a compiled level is checked against. Reading a small text file is cheap;
+  // it is parsing it that compiling avoids
+static bool sourceStamp(const string& path, uint64_t& size, uint64_t& hash)
+{
+	ifstream in(path, ios::binary);
+	if (!in)
+		return false;
+	ostringstream contents;
+	contents << in.rdbuf();
+	string text = contents.str();
+	size = text.size();
+	hash = fnv1a(text.data(), text.size());
+	return true;
+}
+
+static string directoryOf(const string& path)
+{
+	string::size_type slash = path.find_last_of("/\\");
+	return slash == string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+}
+
+static bool isTerrain(Level::GridEntry entry)
+{
+	switch (entry)
+	{
+	case Level::block:
+	case Level::star_goodie_block:
+	case Level::mushroom_goodie_block:
+	case Level::flower_goodie_block:
+	case Level::pipe:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint64_t roundUp(uint64_t bytes)
+{
+	return (bytes + 7) / 8 * 8;
+}
+
+  // True if a table of count elements of the given size lies within the file at a properly aligned offset
+static bool tableFits(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize)
+{
+	return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+CompiledLevel::CompiledLevel()
+ : m_file(nullptr)
+{
+	release();
+}
+
+CompiledLevel::~CompiledLevel()
+{
+	release();
+}
+
+void CompiledLevel::release()
+{
+	delete m_file;
+	m_file = nullptr;
+	m_image.clear();
+	m_grid = nullptr;
+	m_spawns = nullptr;
+	m_numSpawns = 0;
+	m_spans = nullptr;
+	m_numSpans = 0;
+	m_terrainWords = nullptr;
+	m_numTerrainWords = 0;
+}
+
+string CompiledLevel::binaryPathFor(string textPath)
+{
+	string::size_type dot = textPath.find_last_of('.');
+	string::size_type slash = textPath.find_last_of("/\\");
+	if (dot != string::npos && (slash == string::npos || dot > slash))
+		textPath.erase(dot);
+	return textPath + ".lvb";
+}
+
+  // In the cache, levels from different directories are told apart by a hash of the text file's path
+string CompiledLevel::cachePathFor(string textPath)
+{
+	string dir = userCacheDirectory();
+	if (dir.empty())
+		return "";
+	dir += "/SuperPeachSisters";
+	if (!makeDirectory(dir))
+		return "";
+	string binaryPath = binaryPathFor(textPath);
+	string::size_type slash = binaryPath.find_last_of("/\\");
+	string name = (slash == string::npos ? binaryPath : binaryPath.substr(slash + 1));
+	ostringstream path;
+	path << dir << '/' << name.substr(0, name.size() - 4) << '-' << hex << fnv1a(textPath.data(), textPath.size()) << ".lvb";
+	return path.str();
+}
+
+Level::LoadResult CompiledLevel::compile(string textPath, vector<uint64_t>& image)
+{
+	Level lev("");
+	Level::LoadResult result = lev.loadLevel(textPath);
+	if (result != Level::load_success)
+		return result;
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.gridWidth = GRID_WIDTH;
+	header.gridHeight = GRID_HEIGHT;
+	if (!sourceStamp(textPath, header.sourceSize, header.sourceHash))
+		return Level::load_fail_file_not_found;
+
+	vector<uint8_t> grid(GRID_WIDTH * GRID_HEIGHT);
+	vector<Spawn> spawns;
+	for (int gx = 0; gx < GRID_WIDTH; gx++)  // Column by column, the order init() has always created Actors in
+	{
+		for (int gy = 0; gy < GRID_HEIGHT; gy++)
+		{
+			Level::GridEntry entry = lev.getContentsOf(gx, gy);
+			grid[gy * GRID_WIDTH + gx] = static_cast<uint8_t>(entry);
+			if (entry != Level::empty)
+			{
+				Spawn spawn = { static_cast<uint8_t>(entry), 0, static_cast<int16_t>(gx * SPRITE_WIDTH), static_cast<int16_t>(gy * SPRITE_HEIGHT) };
+				spawns.push_back(spawn);
+			}
+		}
+	}
+
+	vector<Span> spans;
+	TerrainMap terrain;
+	for (int gy = 0; gy < GRID_HEIGHT; gy++)
+	{
+		for (int gx = 0; gx < GRID_WIDTH; gx++)
+		{
+			if (!isTerrain(lev.getContentsOf(gx, gy)))
+				continue;
+			int last = gx;
+			while (last + 1 < GRID_WIDTH && isTerrain(lev.getContentsOf(last + 1, gy)))
+				last++;
+			Span span = { static_cast<int16_t>(gx * SPRITE_WIDTH), static_cast<int16_t>(last * SPRITE_WIDTH),
+						  static_cast<int16_t>(gy * SPRITE_HEIGHT), 0 };
+			spans.push_back(span);
+			terrain.addSpan(span.x0, span.x1, span.y);
+			gx = last;
+		}
+	}
+	const vector<uint64_t>& words = terrain.words();
+
+	header.numSpawns = static_cast<uint32_t>(spawns.size());
+	header.numSpans = static_cast<uint32_t>(spans.size());
+	header.numTerrainWords = static_cast<uint32_t>(words.size());
+	header.gridOffset = roundUp(sizeof(Header));
+	header.spawnsOffset = roundUp(header.gridOffset + grid.size());
+	header.spansOffset = roundUp(header.spawnsOffset + spawns.size() * sizeof(Spawn));
+	header.terrainOffset = roundUp(header.spansOffset + spans.size() * sizeof(Span));
+	uint64_t fileSize = header.terrainOffset + words.size() * sizeof(uint64_t);
+
+	image.assign(fileSize / sizeof(uint64_t), 0);
+	char* bytes = reinterpret_cast<char*>(image.data());
+	memcpy(bytes, &header, sizeof(header));
+	memcpy(bytes + header.gridOffset, grid.data(), grid.size());
+	if (!spawns.empty())
+		memcpy(bytes + header.spawnsOffset, spawns.data(), spawns.size() * sizeof(Spawn));
+	if (!spans.empty())
+		memcpy(bytes + header.spansOffset, spans.data(), spans.size() * sizeof(Span));
+	memcpy(bytes + header.terrainOffset, words.data(), words.size() * sizeof(uint64_t));
+	return Level::load_success;
+}
+
+  // The image is written under a name of its own and then renamed into place, so that other worlds (or other processes) loading the same
+  // level at the same time never see a half-written file
+static bool writeImage(const vector<uint64_t>& image, const string& binaryPath)
+{
+	ostringstream tempPath;
+	tempPath << binaryPath << '.' << processID() << '.' << this_thread::get_id() << ".tmp";
+	{
+		ofstream out(tempPath.str(), ios::binary);
+		out.write(reinterpret_cast<const char*>(image.data()), image.size() * sizeof(uint64_t));
+		if (!out)
+		{
+			out.close();
+			remove(tempPath.str().c_str());
+			return false;
+		}
+	}
+	if (!replaceFile(tempPath.str(), binaryPath))
+	{
+		remove(tempPath.str().c_str());
+		return false;
+	}
+	return true;
+}
+
+Level::LoadResult CompiledLevel::compileFile(string textPath, string binaryPath)
+{
+	vector<uint64_t> image;
+	Level::LoadResult result = compile(textPath, image);
+	if (result == Level::load_success && !writeImage(image, binaryPath))
+		return Level::load_fail_file_not_found;
+	return result;
+}
+
+Level::LoadResult CompiledLevel::load(string textPath)
+{
+	release();
+	string binaryPath = binaryPathFor(textPath);
+	uint64_t sourceSize = 0;
+	uint64_t sourceHash = 0;
+	bool haveSource = sourceStamp(textPath, sourceSize, sourceHash);
+
+	  // A binary beside the text (i.e. one shipped with the game) comes first, then one the game compiled into the cache before
+	m_file = new MappedFile;
+	if (m_file->open(binaryPath) && attach(m_file->data(), m_file->size(), haveSource, sourceSize, sourceHash))
+		return Level::load_success;
+	string cachePath = haveSource ? cachePathFor(textPath) : "";
+	if (!cachePath.empty() && m_file->open(cachePath) && attach(m_file->data(), m_file->size(), true, sourceSize, sourceHash))
+		return Level::load_success;
+	delete m_file;
+	m_file = nullptr;
+	if (!haveSource)
+		return Level::load_fail_file_not_found;
+
+	  // Missing, stale or damaged: compile the text again, and save the result for next time if possible. It goes beside the text only if
+	  // that directory can be written to, since an installed game's assets usually can't be; otherwise it goes to the cache
+	Level::LoadResult result = compile(textPath, m_image);
+	if (result != Level::load_success)
+		return result;
+	if (directoryWritable(directoryOf(textPath)))
+		writeImage(m_image, binaryPath);
+	else if (!cachePath.empty())
+		writeImage(m_image, cachePath);
+	attach(m_image.data(), m_image.size() * sizeof(uint64_t), false, 0, 0);
+	return Level::load_success;
+}
+
+bool CompiledLevel::attach(const void* data, size_t size, bool checkSource, uint64_t sourceSize, uint64_t sourceHash)
+{
+	if (size < sizeof(Header))
+		return false;
+	const char* bytes = static_cast<const char*>(data);
+	const Header* header = reinterpret_cast<const Header*>(bytes);
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION || header->byteOrder != BYTE_ORDER_MARK ||
+			header->gridWidth != GRID_WIDTH || header->gridHeight != GRID_HEIGHT)
+		return false;
+	if (checkSource && (header->sourceSize != sourceSize || header->sourceHash != sourceHash))
+		return false;
+	if (!tableFits(header->gridOffset, GRID_WIDTH * GRID_HEIGHT, 1, size) ||
+			!tableFits(header->spawnsOffset, header->numSpawns, sizeof(Spawn), size) ||
+			!tableFits(header->spansOffset, header->numSpans, sizeof(Span), size) ||
+			!tableFits(header->terrainOffset, header->numTerrainWords, sizeof(uint64_t), size))
+		return false;
+
+	m_grid = reinterpret_cast<const uint8_t*>(bytes + header->gridOffset);
+	m_spawns = reinterpret_cast<const Spawn*>(bytes + header->spawnsOffset);
+	m_numSpawns = header->numSpawns;
+	m_spans = reinterpret_cast<const Span*>(bytes + header->spansOffset);
+	m_numSpans = header->numSpans;
+	m_terrainWords = reinterpret_cast<const uint64_t*>(bytes + header->terrainOffset);
+	m_numTerrainWords = header->numTerrainWords;
+	return true;
+}
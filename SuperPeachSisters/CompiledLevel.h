@@ -0,0 +1,86 @@
+#ifndef COMPILEDLEVEL_H_
+#define COMPILEDLEVEL_H_
+
+#include "Level.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// A level in the binary form that init() loads. Text level files stay the authoring format; compiling one validates it with the Level
+// loader once and stores everything init() derives from the text, ready to use in place: the grid, the terrain blocking bitmap, the
+// terrain merged into horizontal spans, and the list of Actors to create, in the order init() creates them. A compiled level sits next to
+// its text file (level01.txt compiles to level01.lvb), or in the user's cache directory if the text file's directory can't be written to,
+// and records the text file's size and a hash of its contents, so load() can notice when the text has changed and compile it again.
+// Loading an up-to-date binary maps the file into memory, checks that every table lies within it, and points at them
+class CompiledLevel
+{
+public:
+	struct Spawn
+	{
+		uint8_t		entry;		// A Level::GridEntry
+		uint8_t		reserved;
+		int16_t		x;			// Lower-left corner in pixels
+		int16_t		y;
+	};
+
+	  // A run of adjacent terrain tiles (Blocks of every kind, and Pipes) in one row, by the lower-left corners of its first and last tiles
+	struct Span
+	{
+		int16_t		x0;
+		int16_t		x1;
+		int16_t		y;
+		int16_t		reserved;
+	};
+
+	CompiledLevel();
+	~CompiledLevel();
+
+	  // Load the level whose text is at textPath from its compiled form, compiling it first if there is no binary or the text has changed
+	  // since. If the binary can be written neither beside the text nor to the cache, the level is compiled into memory instead. Without
+	  // the text file, an existing binary beside where it would be is used as it is
+	Level::LoadResult load(std::string textPath);
+
+	  // Compile a text level to a binary image, or write one to a file
+	static Level::LoadResult compile(std::string textPath, std::vector<uint64_t>& image);
+	static Level::LoadResult compileFile(std::string textPath, std::string binaryPath);
+	static std::string binaryPathFor(std::string textPath);
+	static std::string cachePathFor(std::string textPath);	// Empty if there is no cache directory to use
+
+	Level::GridEntry getContentsOf(int gx, int gy) const
+	{
+		if (gx < 0 || gx >= GRID_WIDTH || gy < 0 || gy >= GRID_HEIGHT)
+			return Level::empty;
+		return static_cast<Level::GridEntry>(m_grid[gy * GRID_WIDTH + gx]);
+	}
+
+	const Spawn* spawns() const { return m_spawns; }
+	size_t numSpawns() const { return m_numSpawns; }
+	const Span* spans() const { return m_spans; }
+	size_t numSpans() const { return m_numSpans; }
+	const uint64_t* terrainWords() const { return m_terrainWords; }
+	size_t numTerrainWords() const { return m_numTerrainWords; }
+
+private:
+	struct Header;
+	class MappedFile;
+
+	MappedFile*				m_file;		// The mapped binary, if the level came from one
+	std::vector<uint64_t>	m_image;	// Otherwise the level compiled in memory
+	const uint8_t*			m_grid;
+	const Spawn*			m_spawns;
+	size_t					m_numSpawns;
+	const Span*				m_spans;
+	size_t					m_numSpans;
+	const uint64_t*			m_terrainWords;
+	size_t					m_numTerrainWords;
+
+	bool attach(const void* data, size_t size, bool checkSource, uint64_t sourceSize, uint64_t sourceHash);
+	void release();
+
+	  // Prevent copying or assigning CompiledLevels
+	CompiledLevel(const CompiledLevel&);
+	CompiledLevel& operator=(const CompiledLevel&);
+};
+
+#endif // COMPILEDLEVEL_H_
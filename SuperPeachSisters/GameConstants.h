@@ -21,6 +21,8 @@ const int IID_FLAG = 11;
 const int IID_PIRANHA_FIRE = 12;
 const int IID_PEACH_FIRE = 13;
 
+const int NUM_IMAGE_IDS = 14;
+
 // sounds
 
 const int SOUND_PLAYER_DIE = 0;
@@ -37,6 +39,8 @@ const int SOUND_PIRANHA_FIRE = 10;
 const int SOUND_THEME = 11;
 const int SOUND_NONE = -1;
 
+const int NUM_SOUND_IDS = 12;
+
 // keys the user can hit
 
 const int KEY_PRESS_LEFT   = 1000;
@@ -74,15 +78,16 @@ const int GWSTATUS_LEVEL_ERROR    = 4;
 
 const int NUM_TEST_PARAMS = 1;
 
-// Return a uniformly distributed random int from min to max, inclusive
+// Return a uniformly distributed random int from min to max, inclusive. This draws from a per-thread engine that is not seeded reproducibly,
+// so it is only for cosmetic effects; anything that affects the game uses GameWorld::random() instead
 
 inline
 int randInt(int min, int max)
 {
     if (max < min)
         std::swap(max, min);
-    static std::random_device rd;
-    static std::default_random_engine generator(rd());
+    static thread_local std::random_device rd;
+    static thread_local std::default_random_engine generator(rd());
     std::uniform_int_distribution<> distro(min, max);
     return distro(generator);
 }
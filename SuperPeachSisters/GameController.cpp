@@ -12,6 +12,9 @@
 #include <cstdlib>
 #include <algorithm>
 #include <iostream>
+#include <random>
+#include <chrono>
+#include <cmath>
 using namespace std;
 
 /*
@@ -52,7 +55,8 @@ static const double SCORE_Z = -10;
 
 static const int MS_PER_FRAME = 5;
 
-int GameController::m_ms_per_tick = kDefaultMsPerTick;
+  // The controller whose run() is in progress, for the GLUT callbacks
+static GameController* activeController = nullptr;
 
 struct SpriteInfo
 {
@@ -64,10 +68,10 @@ struct SpriteInfo
 
 static void convertToGlutCoords(double x, double y, double& gx, double& gy, double& gz);
 static void drawPrompt(string mainMessage, string secondMessage);
-static void drawScoreAndLives(string);
+static void drawScoreAndLives(string, Random&);
 
 enum GameController::GameControllerState : int {
-	welcome, contgame, finishedlevel, init, cleanup, makemove, animate, gameover, prompt, quit, not_applicable
+	welcome, contgame, finishedlevel, init, restartlevel, cleanup, makemove, animate, gameover, prompt, quit, not_applicable
 };
 
 void GameController::initDrawersAndSounds()
@@ -121,50 +125,122 @@ void GameController::initDrawersAndSounds()
 		m_imageNameMap[d.imageID] = d.imageName;
 	}
 	for (int k = 0; k < sizeof(sounds) / sizeof(sounds[0]); k++)
-		m_soundMap[sounds[k].first] = sounds[k].second;
+	{
+		string path = m_gw->assetPath();
+		if (!path.empty())
+			path += '/';
+		m_sounds[sounds[k].first] = m_soundFX.loadClip(path + sounds[k].second);
+		m_soundLoaded[sounds[k].first] = true;
+	}
 }
 
-static void doSomethingCallback()
+static void renderCallback()
 {
-	Game().doSomething();
+	activeController->render();
 }
 
 static void reshapeCallback(int w, int h)
 {
-	Game().reshape(w, h);
+	activeController->reshape(w, h);
 }
 
 static void keyboardEventCallback(unsigned char key, int x, int y)
 {
-	Game().keyboardEvent(key, x, y);
+	activeController->keyboardEvent(key, x, y);
 }
 
 static void specialKeyboardEventCallback(int key, int x, int y)
 {
-	Game().specialKeyboardEvent(key, x, y);
+	activeController->specialKeyboardEvent(key, x, y);
 }
 
+  // The timer only keeps itself going while something is happening on screen; otherwise input events restart it
 void GameController::timerFuncCallback(int)
 {
-	Game().doSomething();
+	GameController* controller = activeController;
+	controller->m_timerArmed = false;
+	controller->doSomething();
+	if (controller->isIdle())
+		return;
+	controller->m_timerArmed = true;
 	glutTimerFunc(MS_PER_FRAME, timerFuncCallback, 0);
 }
 
 #if defined(__APPLE__)
 void windowCloseCallback()
 {
-	SoundFX().abortClip();
+	activeController->soundFX().abortClip();
 }
 #endif
 
+GameController::GameController()
+ : m_gw(nullptr), m_gameState(welcome), m_nextStateAfterPrompt(welcome), m_nextStateAfterAnimate(not_applicable),
+   m_lastKeyHit(INVALID_KEY), m_singleStep(false), m_quitRequested(false), m_timerArmed(false), m_redraw(false), m_accumulatedMs(0), m_playerWon(false),
+   m_replaying(false), m_simThreaded(false), m_stopSim(false), m_simStatus(GWSTATUS_CONTINUE_GAME), m_simWaiting(false), m_ms_per_tick(kDefaultMsPerTick)
+{
+	for (int k = 0; k < NUM_SOUND_IDS; k++)
+		m_soundLoaded[k] = false;
+	for (int i = 0; i < GraphObjectRegistry::NUM_DEPTHS; i++)
+	{
+		m_layerCache[i].list = 0;
+		m_layerCache[i].compiled = false;
+		m_layerCache[i].compiledVersion = 0;
+		m_layerCache[i].drawn = false;
+		m_layerCache[i].drawnVersion = 0;
+	}
+}
+
 void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTitle)
 {
+	m_replaying = false;
+	m_simThreaded = false;
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (arg == "--sim-thread")
+			m_simThreaded = true;
+		else if (k + 1 == argc)
+			break;
+		else if (arg == "--record")
+			m_recordFile = argv[++k];
+		else if (arg == "--replay")
+		{
+			if (!m_replay.load(argv[++k]))
+				cerr << "Cannot read recording " << argv[k] << ", ignoring it" << endl;
+			else
+				m_replaying = true;
+		}
+	}
+
+	  // An interactive game should play differently each time, so both streams are seeded unpredictably, unless a recording says otherwise
+	random_device rd;
+	m_hudRandom.seed((static_cast<uint64_t>(rd()) << 32) | rd());
+	if (m_replaying)
+	{
+		gw->setSeed(m_replay.seed());
+		for (int k = 1; k < m_replay.startLevel(); k++)
+			gw->advanceToNextLevel();
+	}
+	else
+		gw->setSeed((static_cast<uint64_t>(rd()) << 32) | rd());
+	if (!m_recordFile.empty())
+	{
+		m_recording.setSeed(gw->getSeed());
+		m_recording.setStartLevel(gw->getLevel());
+		gw->setRecorder(&m_recording);
+	}
+
 	gw->setController(this);
 	m_gw = gw;
+	m_graphObjects = gw->graphObjectRegistry();
+	activeController = this;
 	setGameState(welcome);
 	m_lastKeyHit = INVALID_KEY;
 	m_singleStep = false;
-	m_curIntraFrameTick = 0;
+	m_quitRequested = false;
+	m_redraw = true;
+	m_accumulatedMs = 0;
+	m_lastUpdate = Clock::now();
 	m_playerWon = false;
 
 	glutInit(&argc, argv);
@@ -179,7 +255,8 @@ void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTit
 	glutKeyboardFunc(keyboardEventCallback);
 	glutSpecialFunc(specialKeyboardEventCallback);
 	glutReshapeFunc(reshapeCallback);
-	glutDisplayFunc(doSomethingCallback);
+	glutDisplayFunc(renderCallback);
+	m_timerArmed = true;
 	glutTimerFunc(MS_PER_FRAME, timerFuncCallback, 0);
 #if defined(__APPLE__)
 	glutWMCloseFunc(windowCloseCallback);
@@ -187,8 +264,13 @@ void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTit
 
 	glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
 	glutMainLoop();
+	stopSimulation();
+	if (!m_recordFile.empty() && !m_recording.saveRecording(m_recordFile))
+		cerr << "Cannot write recording " << m_recordFile << endl;
 	delete m_gw;
+	m_gw = nullptr;
 	reportLeakedGraphObjects();
+	activeController = nullptr;
 }
 
 void GameController::keyboardEvent(unsigned char key, int /* x */, int /* y */)
@@ -205,6 +287,14 @@ void GameController::keyboardEvent(unsigned char key, int /* x */, int /* y */)
 	case 'q': case 'Q': setGameState(quit);				break;
 	default:			m_lastKeyHit = key;				break;
 	}
+	inputEvent();
+}
+
+bool GameController::getLastKey(int& value)
+{
+	if (m_replaying)
+		return m_replayCursor.keyAt(m_replay, m_gw->getTickCount(), value);
+	return getKeyboardKey(value);
 }
 
 void GameController::specialKeyboardEvent(int key, int /* x */, int /* y */)
@@ -217,6 +307,56 @@ void GameController::specialKeyboardEvent(int key, int /* x */, int /* y */)
 	case GLUT_KEY_DOWN:	 m_lastKeyHit = KEY_PRESS_DOWN;	 break;
 	default:			 m_lastKeyHit = INVALID_KEY;	 break;
 	}
+	inputEvent();
+}
+
+  // Whatever was waiting for the player can go on now: wake the simulation thread if it is waiting for a single-step key, and restart
+  // the timer if it had stopped. GLUT can only be called from this thread, so the timer is restarted here rather than by the simulation
+  // thread, and keeps going until that thread has made its step and gone back to sleep
+void GameController::inputEvent()
+{
+	{
+		lock_guard<mutex> lock(m_inputMutex);
+		m_simWaiting = false;
+	}
+	m_inputArrived.notify_one();
+
+	if (!m_timerArmed)
+	{
+		m_timerArmed = true;
+		m_lastUpdate = Clock::now();	// waiting for the player isn't time the world should make up
+		glutTimerFunc(0, timerFuncCallback, 0);
+	}
+}
+
+  // True when nothing will change until the player presses a key: a prompt, or single-stepping. With the world on its own thread, that is
+  // once the thread is asleep waiting for a key and its last step has been drawn
+bool GameController::isIdle() const
+{
+	if (m_gameState == prompt)
+		return !(m_replaying && m_nextStateAfterPrompt != quit);
+	if (m_gameState != makemove || !m_singleStep)
+		return false;
+	return !m_simThreaded || (m_simWaiting && !m_snapshots.pending());
+}
+
+  // Timed frames are only drawn when they would differ from the last one; GLUT itself asks for a redraw when the window is exposed or
+  // resized
+bool GameController::needsRedraw() const
+{
+	if (m_redraw)
+		return true;
+	switch (m_gameState)
+	{
+	case prompt:
+		return false;
+	case makemove:
+		if (!m_singleStep)
+			return true;
+		return m_simThreaded && m_snapshots.pending();
+	default:
+		return true;
+	}
 }
 
 void GameController::playSound(int soundID)
@@ -224,141 +364,297 @@ void GameController::playSound(int soundID)
 	if (soundID == SOUND_NONE)
 		return;
 
-	SoundMapType::const_iterator p = m_soundMap.find(soundID);
-	if (p != m_soundMap.end())
-	{
-		string path = m_gw->assetPath();
-		if (!path.empty())
-			path += '/';
-		SoundFX().playClip(path + p->second);
-	}
+	if (soundID >= 0 && soundID < NUM_SOUND_IDS && m_soundLoaded[soundID])
+		m_soundFX.playClip(m_sounds[soundID]);
 }
 
 void GameController::setGameState(GameControllerState s)
 {
-	if (m_gameState != quit)
+	if (m_gameState != quit && m_gameState != s)
+	{
 		m_gameState = s;
+		m_redraw = true;
+	}
 }
+  // May be called by the world from the simulation thread, so the state only changes on the next update()
 void GameController::quitGame()
 {
-	setGameState(quit);
+	m_quitRequested = true;
 }
 
 void GameController::doSomething()
 {
-	switch (m_gameState)
+	update();
+	if (needsRedraw())
+		render();
+}
+
+  // Advance the state machine to the present. Most states take no time and are passed through immediately; while a level is being played,
+  // the world runs one tick per m_ms_per_tick of real time as measured on a monotonic clock, however often this happens to be called
+void GameController::update()
+{
+	Clock::time_point now = Clock::now();
+	double elapsedMs = chrono::duration<double, milli>(now - m_lastUpdate).count();
+	m_lastUpdate = now;
+	if (m_quitRequested)
+		setGameState(quit);
+
+	for (;;)
 	{
-	case not_applicable:
-		break;
-	case welcome:
-		playSound(SOUND_THEME);
-		m_mainMessage = "Welcome to Super Peach Sisters!";
-		m_secondMessage = "Press Enter to begin play...";
-		setGameState(prompt);
-		m_nextStateAfterPrompt = init;
-		break;
-	case contgame:
-		m_mainMessage = "You lost a life!";
-		m_secondMessage = "Press Enter to continue playing...";
+		switch (m_gameState)
+		{
+		case not_applicable:
+			return;
+		case welcome:
+			playSound(SOUND_THEME);
+			m_mainMessage = "Welcome to Super Peach Sisters!";
+			m_secondMessage = "Press Enter to begin play...";
+			setGameState(prompt);
+			m_nextStateAfterPrompt = init;
+			break;
+		case contgame:
+			m_mainMessage = "You lost a life!";
+			m_secondMessage = "Press Enter to continue playing...";
+			setGameState(prompt);
+			m_nextStateAfterPrompt = restartlevel;
+			break;
+		case finishedlevel:
+			m_mainMessage = "Woot! You finished the level!";
+			m_secondMessage = "Press Enter to continue playing...";
+			setGameState(prompt);
+			m_nextStateAfterPrompt = cleanup;
+			break;
+		case makemove:
+		{
+			int status;
+			if (m_simThreaded)
+			{
+				status = m_simStatus;
+				if (status == GWSTATUS_CONTINUE_GAME)
+					return;
+				stopSimulation();	// the world is this thread's again
+			}
+			else
+				status = runTicks(elapsedMs);
+			if (status != GWSTATUS_CONTINUE_GAME)
+				endPlay(status);
+			return;
+		}
+		case animate:
+			  // The last tick of a life or level has been on screen for a frame; move on
+			setGameState(m_nextStateAfterAnimate);
+			break;
+		case cleanup:
+			m_gw->cleanUp();
+			setGameState(init);
+			break;
+		case gameover:
+		{
+			ostringstream oss;
+			oss << (m_playerWon ? "You won the game!" : "Game Over!")
+				<< " Final score: " << m_gw->getScore() << "!";
+			m_mainMessage = oss.str();
+		}
+		m_secondMessage = "Press Enter to quit...";
 		setGameState(prompt);
-		m_nextStateAfterPrompt = cleanup;
+		m_nextStateAfterPrompt = quit;
 		break;
-	case finishedlevel:
-		m_mainMessage = "Woot! You finished the level!";
-		m_secondMessage = "Press Enter to continue playing...";
-		setGameState(prompt);
-		m_nextStateAfterPrompt = cleanup;
+		case prompt:
+		{
+			  // A replay carries on by itself, only stopping at the end for the final score
+			int key;
+			if ((m_replaying && m_nextStateAfterPrompt != quit) || (getKeyboardKey(key) && key == '\r'))
+				setGameState(m_nextStateAfterPrompt);
+			else
+				return;
+		}
 		break;
-	case makemove:
-		m_curIntraFrameTick = ANIMATION_POSITIONS_PER_TICK;
-		m_nextStateAfterAnimate = not_applicable;
+		case init:
+		case restartlevel:
 		{
-			int status = m_gw->move();
-			if (status == GWSTATUS_PLAYER_DIED)
-			{
-				// animate one last frame so the Ego can see what happened
-				m_nextStateAfterAnimate = (m_gw->isGameOver() ? gameover : contgame);
-			}
-			else if (status == GWSTATUS_FINISHED_LEVEL)
+			int status = (m_gameState == init ? m_gw->init() : m_gw->restartLevel());
+			m_soundFX.abortClip();
+			if (status == GWSTATUS_PLAYER_WON)
 			{
-				m_gw->advanceToNextLevel();
-				// animate one last frame so the Ego can see what happened
-				m_nextStateAfterAnimate = finishedlevel;
+				m_playerWon = true;
+				setGameState(gameover);
 			}
-			else if (status == GWSTATUS_PLAYER_WON)
+			else if (status == GWSTATUS_LEVEL_ERROR)
 			{
-				m_playerWon = true;
-				m_nextStateAfterAnimate = gameover;
+				m_mainMessage = "Error in level data file encoding!";
+				m_secondMessage = "Press Enter to quit...";
+				setGameState(prompt);
+				m_nextStateAfterPrompt = quit;
 			}
-		}
-		setGameState(animate);
-		break;
-	case animate:
-		displayGamePlay();
-		if (m_curIntraFrameTick-- <= 0)
-		{
-			if (m_nextStateAfterAnimate != not_applicable)
-				setGameState(m_nextStateAfterAnimate);
 			else
 			{
-				int key;
-				if (!m_singleStep || getLastKey(key))
-					setGameState(makemove);
+				setGameState(makemove);
+				m_accumulatedMs = 0;	// time spent before the level started doesn't count
+				elapsedMs = 0;
+				if (m_simThreaded)
+					startSimulation();
 			}
 		}
 		break;
-	case cleanup:
-		m_gw->cleanUp();
-		setGameState(init);
-		break;
-	case gameover:
+		case quit:
+			stopSimulation();
+			m_soundFX.abortClip();
+			glutLeaveMainLoop();
+			return;
+		}
+	}
+}
+
+  // Run however many ticks are due and return the status of the last one. If the world has fallen more than MAX_CATCH_UP_TICKS behind
+  // (a slow machine, or the window being dragged), the rest of the backlog is dropped rather than letting the game race to catch up
+int GameController::runTicks(double elapsedMs)
+{
+	if (m_singleStep)
 	{
-		ostringstream oss;
-		oss << (m_playerWon ? "You won the game!" : "Game Over!")
-			<< " Final score: " << m_gw->getScore() << "!";
-		m_mainMessage = oss.str();
+		int key;
+		if (!getKeyboardKey(key))
+		{
+			m_accumulatedMs = 0;
+			return GWSTATUS_CONTINUE_GAME;
+		}
+		m_accumulatedMs = m_ms_per_tick;	// exactly one tick per key
 	}
-	m_secondMessage = "Press Enter to quit...";
-	setGameState(prompt);
-	m_nextStateAfterPrompt = quit;
-	break;
-	case prompt:
-		drawPrompt(m_mainMessage, m_secondMessage);
+	else
+		m_accumulatedMs += elapsedMs;
+
+	for (int ticks = 0; m_accumulatedMs >= m_ms_per_tick && !m_quitRequested; ticks++)
+	{
+		if (ticks == MAX_CATCH_UP_TICKS)
 		{
-			int key;
-			if (getLastKey(key) && key == '\r')
-				setGameState(m_nextStateAfterPrompt);
+			m_accumulatedMs = fmod(m_accumulatedMs, m_ms_per_tick);
+			break;
 		}
-		break;
-	case init:
+		m_accumulatedMs -= m_ms_per_tick;
+
+		int status = m_gw->tick();
+		if (m_simThreaded)
+		{
+			m_snapshots.writeBuffer().capture(*m_graphObjects, m_gameStatText);
+			m_snapshots.publish();
+		}
+		else
+			m_redraw = true;
+		if (status != GWSTATUS_CONTINUE_GAME)
+			return status;
+	}
+	return GWSTATUS_CONTINUE_GAME;
+}
+
+void GameController::endPlay(int status)
+{
+	if (status == GWSTATUS_PLAYER_DIED)
+		m_nextStateAfterAnimate = (m_gw->isGameOver() ? gameover : contgame);
+	else if (status == GWSTATUS_FINISHED_LEVEL)
+	{
+		m_gw->advanceToNextLevel();
+		m_nextStateAfterAnimate = finishedlevel;
+	}
+	else if (status == GWSTATUS_PLAYER_WON)
+	{
+		m_playerWon = true;
+		m_nextStateAfterAnimate = gameover;
+	}
+	else
+		return;
+
+	  // show one last frame so the Ego can see what happened
+	setGameState(animate);
+}
+
+void GameController::startSimulation()
+{
+	m_stopSim = false;
+	m_simStatus = GWSTATUS_CONTINUE_GAME;
+	m_simWaiting = false;
+	m_accumulatedMs = 0;
+	m_snapshots.writeBuffer().capture(*m_graphObjects, m_gameStatText);  // so there is something to draw before the first tick
+	m_snapshots.publish();
+	m_simThread = thread(&GameController::simulate, this);
+}
+
+void GameController::stopSimulation()
+{
+	if (!m_simThread.joinable())
+		return;
+	{
+		lock_guard<mutex> lock(m_inputMutex);
+		m_stopSim = true;
+	}
+	m_inputArrived.notify_one();
+	m_simThread.join();
+}
+
+  // The simulation thread: tick on time until play ends or GLUT's thread wants the world back, sleeping whenever no tick is due
+void GameController::simulate()
+{
+	Clock::time_point last = Clock::now();
+	while (!m_stopSim && !m_quitRequested)
 	{
-		int status = m_gw->init();
-		SoundFX().abortClip();
-		if (status == GWSTATUS_PLAYER_WON)
+		Clock::time_point now = Clock::now();
+		int status = runTicks(chrono::duration<double, milli>(now - last).count());
+		last = now;
+		if (status != GWSTATUS_CONTINUE_GAME)
 		{
-			m_playerWon = true;
-			setGameState(gameover);
+			m_simStatus = status;
+			return;
 		}
-		else if (status == GWSTATUS_LEVEL_ERROR)
+		if (m_singleStep)
 		{
-			m_mainMessage = "Error in level data file encoding!";
-			m_secondMessage = "Press Enter to quit...";
-			setGameState(prompt);
-			m_nextStateAfterPrompt = quit;
+			  // Sleep until there is a key to step with, or a reason to stop waiting for one
+			unique_lock<mutex> lock(m_inputMutex);
+			m_simWaiting = true;
+			m_inputArrived.wait(lock, [this]() {
+				return m_lastKeyHit != INVALID_KEY || !m_singleStep || m_stopSim || m_quitRequested;
+			});
+			m_simWaiting = false;
+			last = Clock::now();
 		}
 		else
-			setGameState(makemove);
+			this_thread::sleep_for(chrono::duration<double, milli>(m_ms_per_tick - m_accumulatedMs));
 	}
-	break;
-	case quit:
-		SoundFX().abortClip();
-		glutLeaveMainLoop();
+}
+
+  // Draw whatever the current state shows. Between ticks, moving objects are drawn part of the way from where they were after the
+  // previous tick to where they are now, according to how much of the current tick's time has passed
+void GameController::render()
+{
+	m_redraw = false;
+	switch (m_gameState)
+	{
+	case prompt:
+		drawPrompt(m_mainMessage, m_secondMessage);
+		break;
+	case makemove:
+		if (m_simThreaded)
+		{
+			  // Draw the latest tick published, timing it from when it was captured
+			m_snapshots.update();
+			const WorldSnapshot& snapshot = m_snapshots.readBuffer();
+			double sinceMs = chrono::duration<double, milli>(Clock::now() - snapshot.capturedAt).count();
+			displayGamePlay(snapshot, m_singleStep ? 1.0 : min(sinceMs / m_ms_per_tick, 1.0));
+		}
+		else
+		{
+			m_localSnapshot.capture(*m_graphObjects, m_gameStatText);
+			displayGamePlay(m_localSnapshot, m_singleStep ? 1.0 : min(m_accumulatedMs / m_ms_per_tick, 1.0));
+		}
+		break;
+	case animate:
+		m_localSnapshot.capture(*m_graphObjects, m_gameStatText);
+		displayGamePlay(m_localSnapshot, 1.0);
+		break;
+	default:
 		break;
 	}
 }
 
 
-void GameController::displayGamePlay()
+void GameController::displayGamePlay(const WorldSnapshot& snapshot, double alpha)
 {
 	glEnable(GL_DEPTH_TEST); // must be done each time before displaying graphics or gets disabled for some reason
 	glLoadIdentity();
@@ -372,30 +668,48 @@ void GameController::displayGamePlay()
 #pragma GCC diagnostic pop
 #endif
 
+	  // Each depth goes to the GPU as one batch, drawn farthest first
 	for (int i = GraphObject::NUM_DEPTHS - 1; i >= 0; --i)
 	{
-		std::set<GraphObject*>& graphObjects = GraphObject::getGraphObjects(i);
-
-		for (auto it = graphObjects.begin(); it != graphObjects.end(); it++)
+		const WorldSnapshot::Layer& layer = snapshot.layers[i];
+		LayerCache& cache = m_layerCache[i];
+		unsigned long version = layer.version;
+		if (cache.compiled && cache.compiledVersion == version)
 		{
-			GraphObject* cur = *it;
-			if (cur->isVisible())
-			{
-				cur->animate();
-
-				double x, y, gx, gy, gz;
-				cur->getAnimationLocation(x, y);
-				convertToGlutCoords(x, y, gx, gy, gz);
+			glCallList(cache.list);
+			continue;
+		}
+		  // Only a depth that looks the same as last frame, and will until the next tick, is worth compiling
+		bool settled = (cache.drawn && cache.drawnVersion == version && layer.settled);
+		cache.drawn = true;
+		cache.drawnVersion = version;
 
-				int angle = cur->getDirection();
-				int imageID = cur->getID();
+		m_spriteManager.beginBatch();
+		for (size_t k = 0; k < layer.sprites.size(); k++)
+		{
+			const WorldSnapshot::Sprite& sprite = layer.sprites[k];
+			double x = sprite.startX + (sprite.x - sprite.startX) * alpha;
+			double y = sprite.startY + (sprite.y - sprite.startY) * alpha;
+			double gx, gy, gz;
+			convertToGlutCoords(x, y, gx, gy, gz);
 
-				m_spriteManager.plotSprite(imageID, cur->getAnimationNumber() % m_spriteManager.getNumFrames(imageID), gx, gy, gz, angle, cur->getSize());
-			}
+			m_spriteManager.addSprite(sprite.imageID, sprite.frame % m_spriteManager.getNumFrames(sprite.imageID), gx, gy, gz, sprite.direction, sprite.size);
+		}
+		if (settled)
+		{
+			if (cache.list == 0)
+				cache.list = glGenLists(1);
+			glNewList(cache.list, GL_COMPILE_AND_EXECUTE);
+			m_spriteManager.drawBatch();
+			glEndList();
+			cache.compiled = true;
+			cache.compiledVersion = version;
 		}
+		else
+			m_spriteManager.drawBatch();
 	}
 
-	drawScoreAndLives(m_gameStatText);
+	drawScoreAndLives(snapshot.statText, m_hudRandom);
 
 	glutSwapBuffers();
 }
@@ -405,7 +719,7 @@ void GameController::reportLeakedGraphObjects() const
 	int totalLeaked = 0;
 	for (int i = 0; i < GraphObject::NUM_DEPTHS; i++)
 	{
-		set<GraphObject*>& graphObjects = GraphObject::getGraphObjects(i);
+		const GraphObjectRegistry::Layer& graphObjects = m_graphObjects->objects(i);
 		if (graphObjects.empty())
 			continue;
 		cerr << "***** " << graphObjects.size() << " leaked objects at graphical depth " << i << ":" << endl;
@@ -485,14 +799,14 @@ static void drawPrompt(string mainMessage, string secondMessage)
 	glutSwapBuffers();
 }
 
-static void drawScoreAndLives(string gameStatText)
+static void drawScoreAndLives(string gameStatText, Random& random)
 {
 	static int RATE = 1;
 	static GLfloat rgb[3] =
 	{ static_cast<GLfloat>(.6), static_cast<GLfloat>(.6), static_cast<GLfloat>(.6) };
 	for (int k = 0; k < 3; k++)
 	{
-		double strength = rgb[k] + (-RATE + randInt(0, 2 * RATE)) / 100.0;
+		double strength = rgb[k] + (-RATE + random.randInt(0, 2 * RATE)) / 100.0;
 		if (strength < .6)
 			strength = .6;
 		else if (strength > 1.0)
@@ -1,91 +1,153 @@
 #ifndef GAMECONTROLLER_H_
 #define GAMECONTROLLER_H_
 
+#include "GameHost.h"
+#include "GameConstants.h"
 #include "SpriteManager.h"
+#include "GraphObject.h"
+#include "Random.h"
+#include "InputScript.h"
+#include "SoundFX.h"
+#include "TripleBuffer.h"
+#include "WorldSnapshot.h"
 #include <string>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 const int INVALID_KEY = 0;
 
-class GraphObject;
 class GameWorld;
 
-class GameController
+  // Plays a GameWorld in a GLUT window. Each controller owns its own sound output and keeps the world's GraphObject registry, so nothing
+  // is process-wide apart from GLUT itself, which only ever drives the controller whose run() is in progress
+class GameController : public GameHost
 {
 public:
+	GameController();
+
+	  // Besides GLUT's own options, argv may contain --record file, to save the keys the world reads (and its seed) when the game ends,
+	  // --replay file, to play such a recording back at normal speed instead of taking keys from the keyboard, or --sim-thread, to run
+	  // the world on a thread of its own so that its ticks overlap with drawing
 	void run(int argc, char* argv[], GameWorld* gw, std::string windowTitle);
 
-	bool getLastKey(int& value)
-	{
-		if (m_lastKeyHit != INVALID_KEY)
-		{
-			value = m_lastKeyHit;
-			m_lastKeyHit = INVALID_KEY;
-			return true;
-		}
-		return false;
-	}
+	virtual bool getLastKey(int& value);
 
-	void playSound(int soundID);
+	virtual void playSound(int soundID);
 
-	void setGameStatText(std::string text)
+	virtual void setGameStatText(std::string text)
 	{
 		m_gameStatText = text;
 	}
 
 	void doSomething();
+	void update();
+	void render();
 
 	void reshape(int w, int h);
 	void keyboardEvent(unsigned char key, int x, int y);
 	void specialKeyboardEvent(int key, int x, int y);
 
-	void quitGame();
-
-	// Meyers singleton pattern
-	static GameController& getInstance()
-	{
-		static GameController instance;
-		return instance;
-	}
+	virtual void quitGame();
 
 	static void timerFuncCallback(int nothing);
-	void setMsPerTick(int ms_per_tick) { m_ms_per_tick = ms_per_tick; }
+	virtual void setMsPerTick(int ms_per_tick) { m_ms_per_tick = ms_per_tick; }
+
+	SoundFXController& soundFX() { return m_soundFX; }
 
 private:
 	enum GameControllerState : int;
 
 	GameWorld* m_gw;
+	std::shared_ptr<GraphObjectRegistry> m_graphObjects;	// Outlives m_gw so that leaks can be reported after it is deleted
+	SoundFXController m_soundFX;
 	GameControllerState	m_gameState;
 	GameControllerState	m_nextStateAfterPrompt;
 	GameControllerState	m_nextStateAfterAnimate;
-	int			m_lastKeyHit;
-	bool		m_singleStep;
+	std::atomic<int>	m_lastKeyHit;	// Keys and modes are set by GLUT's thread but may be read by the simulation thread
+	std::atomic<bool>	m_singleStep;
+	std::atomic<bool>	m_quitRequested;
+	std::mutex			m_inputMutex;	// Only so the simulation thread can wait for a key without missing it
+	std::condition_variable m_inputArrived;
+	bool		m_timerArmed;	// False while nothing can change until the player does something, and GLUT just waits for events
+	bool		m_redraw;		// What is on screen is out of date
 	std::string m_gameStatText;
 	std::string m_mainMessage;
 	std::string m_secondMessage;
-	int			m_curIntraFrameTick;
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point m_lastUpdate;
+	double		m_accumulatedMs;	// Real time that has passed but not yet been simulated
 	using SoundMapType = std::map<int, std::string>;
 	using DrawMapType = std::map<int, std::string>;
 	using ImageNameMapType = std::map<int, std::string>;
-	SoundMapType m_soundMap;
 	ImageNameMapType m_imageNameMap;
+	SoundFXController::Clip m_sounds[NUM_SOUND_IDS];	// Indexed by sound ID, loaded once in initDrawersAndSounds()
+	bool		m_soundLoaded[NUM_SOUND_IDS];
+
+	  // A depth that looks the same two frames running is compiled into a display list, which is replayed until the depth changes again.
+	  // In practice that is the terrain, which is only touched by init() and cleanUp()
+	struct LayerCache
+	{
+		GLuint			list;			// 0 until first needed
+		bool			compiled;
+		unsigned long	compiledVersion;
+		bool			drawn;
+		unsigned long	drawnVersion;	// As of the last frame
+	};
+	LayerCache	m_layerCache[GraphObjectRegistry::NUM_DEPTHS];
 	bool		m_playerWon;
 	SpriteManager m_spriteManager;
+	Random		m_hudRandom;	// Only for the score flicker, so drawing never disturbs the world's own stream
+	InputScript m_recording;
+	std::string m_recordFile;
+	InputScript m_replay;
+	InputScript::Cursor m_replayCursor;
+	bool		m_replaying;
+
+	  // With --sim-thread, the world's ticks run on m_simThread from the start of play until a life or level ends, while GLUT's thread only
+	  // draws. After every tick the simulation thread publishes a snapshot of the world, which is all that GLUT's thread looks at meanwhile
+	bool		m_simThreaded;
+	std::thread m_simThread;
+	std::atomic<bool> m_stopSim;
+	std::atomic<int> m_simStatus;	// GWSTATUS_CONTINUE_GAME until the tick that ends play
+	std::atomic<bool> m_simWaiting;	// The simulation thread is single-stepping and has gone to sleep until the next key
+	TripleBuffer<WorldSnapshot> m_snapshots;
+	WorldSnapshot m_localSnapshot;	// For drawing the world from GLUT's thread when it owns it
+
+	bool getKeyboardKey(int& value)
+	{
+		int key = m_lastKeyHit.exchange(INVALID_KEY);
+		if (key != INVALID_KEY)
+		{
+			value = key;
+			return true;
+		}
+		return false;
+	}
 
 	void setGameState(GameControllerState s);
 
 	void initDrawersAndSounds();
-	void displayGamePlay();
+	void inputEvent();
+	bool isIdle() const;
+	bool needsRedraw() const;
+	int runTicks(double elapsedMs);
+	void endPlay(int status);
+	void startSimulation();
+	void stopSimulation();
+	void simulate();
+	void displayGamePlay(const WorldSnapshot& snapshot, double alpha);
 	void reportLeakedGraphObjects() const;
 
-	static const int kDefaultMsPerTick = 10;
-	static int m_ms_per_tick;
+	  // the original loop ran one makemove and two animate callbacks on 5 ms timers, so 15 ms keeps the game at its usual pace
+	static const int kDefaultMsPerTick = 15;
+	static const int MAX_CATCH_UP_TICKS = 5;
+	std::atomic<int> m_ms_per_tick;
 };
 
-inline GameController& Game()
-{
-	return GameController::getInstance();
-}
-
 #endif // GAMECONTROLLER_H_
\ No newline at end of file
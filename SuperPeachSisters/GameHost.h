@@ -0,0 +1,22 @@
+#ifndef GAMEHOST_H_
+#define GAMEHOST_H_
+
+#include <string>
+
+// Everything a GameWorld needs from whatever is running it. GameController implements this on top of GLUT; HeadlessHost implements it with
+// scripted input and no output at all, so that the world itself never depends on a window, a GL context or a sound device
+class GameHost
+{
+public:
+	virtual ~GameHost()
+	{
+	}
+
+	virtual bool getLastKey(int& value) = 0;
+	virtual void playSound(int soundID) = 0;
+	virtual void setGameStatText(std::string text) = 0;
+	virtual void setMsPerTick(int ms_per_tick) = 0;
+	virtual void quitGame() = 0;
+};
+
+#endif // GAMEHOST_H_
@@ -1,5 +1,6 @@
 #include "GameWorld.h"
-#include "GameController.h"
+#include "GameHost.h"
+#include "InputScript.h"
 #include <string>
 #include <cstdlib>
 using namespace std;
@@ -10,6 +11,8 @@ bool GameWorld::getKey(int& value)
 
 	if (gotKey)
 	{
+		if (m_recorder != nullptr)
+			m_recorder->add(m_ticks, value);
 		if (value == 'q'  ||  value == '\x03')  // CTRL-C
 			m_controller->quitGame();
 	}
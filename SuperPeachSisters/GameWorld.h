@@ -2,11 +2,15 @@
 #define GAMEWORLD_H_
 
 #include "GameConstants.h"
+#include "Random.h"
+#include "GraphObject.h"
 #include <string>
+#include <memory>
 
 const int START_PLAYER_LIVES = 3;
 
-class GameController;
+class GameHost;
+class InputScript;
 
 class GameWorld
 {
@@ -14,7 +18,8 @@ public:
 
 	GameWorld(std::string assetPath)
 	 : m_lives(START_PLAYER_LIVES), m_score(0), m_level(1),
-	   m_controller(nullptr), m_assetPath(assetPath)
+	   m_ticks(0), m_controller(nullptr), m_assetPath(assetPath), m_seed(0), m_random(0), m_recorder(nullptr),
+	   m_graphObjects(std::make_shared<GraphObjectRegistry>())
 	{
 	}
 
@@ -26,6 +31,14 @@ public:
 	virtual int move() = 0;
 	virtual void cleanUp() = 0;
 
+	  // Start the current level over, e.g. after the player loses a life. Worlds that can put a level back the way init() left it more
+	  // cheaply than tearing it down and building it again override this
+	virtual int restartLevel()
+	{
+		cleanUp();
+		return init();
+	}
+
 	void setGameStatText(std::string text);
 
 	bool getKey(int& value);
@@ -51,6 +64,17 @@ public:
 		m_lives++;
 	}
 
+	  // The world's own random number stream; init() and the Actors draw from it, so a world replays exactly given the same seed and input
+	Random& random()
+	{
+		return m_random;
+	}
+
+	const Random& random() const
+	{
+		return m_random;
+	}
+
 	int getScore() const
 	{
 		return m_score;
@@ -73,23 +97,89 @@ public:
 		++m_level;
 	}
  
-	void setController(GameController* controller)
+	  // Every GraphObject in this world registers itself here. Shared so that a host can keep the registry (and so check it for leaked
+	  // objects) after deleting the world
+	GraphObjectRegistry& graphObjects()
+	{
+		return *m_graphObjects;
+	}
+
+	std::shared_ptr<GraphObjectRegistry> graphObjectRegistry() const
+	{
+		return m_graphObjects;
+	}
+
+	void setController(GameHost* controller)
 	{
 		m_controller = controller;
 	}
 
+	  // Run one move() and count it; tick numbers are what scripted input is keyed on
+	int tick()
+	{
+		m_graphObjects->beginTick();
+		int status = move();
+		m_ticks++;
+		return status;
+	}
+
+	void setSeed(uint64_t seed)
+	{
+		m_seed = seed;
+		m_random.seed(seed);
+	}
+
+	uint64_t getSeed() const
+	{
+		return m_seed;
+	}
+
+	  // Log every key the world reads, with the tick it was read on, into recording (or stop logging, if it is nullptr). The caller keeps
+	  // ownership of the recording and is responsible for giving it the world's seed and starting level before saving it
+	void setRecorder(InputScript* recording)
+	{
+		m_recorder = recording;
+	}
+
+	long getTickCount() const
+	{
+		return m_ticks;
+	}
+
+	  // A hash of the world's whole state, for hash traces of replays; worlds that don't keep one return 0
+	virtual uint64_t stateHash() const
+	{
+		return 0;
+	}
+
 	std::string assetPath() const
 	{
 		return m_assetPath;
 	}
 
 	void setMsPerTick(int ms_per_tick);
+
+protected:
+	  // For worlds restoring a save state: put the player's progress and the tick count back as they were
+	void restoreProgress(int level, int lives, int score, long ticks)
+	{
+		m_level = level;
+		m_lives = lives;
+		m_score = score;
+		m_ticks = ticks;
+	}
+
 private:
 	int				m_lives;
 	int				m_score;
 	int				m_level;
-	GameController* m_controller;
+	long			m_ticks;
+	GameHost*		m_controller;
 	std::string		m_assetPath;
+	uint64_t		m_seed;
+	Random			m_random;
+	InputScript*	m_recorder;
+	std::shared_ptr<GraphObjectRegistry> m_graphObjects;
 };
 
 #endif // GAMEWORLD_H_
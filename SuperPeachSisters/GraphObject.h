@@ -1,13 +1,152 @@
 #ifndef GRAPHOBJ_H_
 #define GRAPHOBJ_H_
 
-#include "SpriteManager.h"
 #include "GameConstants.h"
 
-#include <set>
+#include <cstddef>
 #include <cmath>
 
-const int ANIMATION_POSITIONS_PER_TICK = 1;
+class GraphObject;
+
+  // The GraphObjects that exist in one world, by depth, for the framework to draw. Each GameWorld owns its own registry, so worlds on
+  // different threads never share one. Each depth is a doubly linked list threaded through the GraphObjects themselves, so registering
+  // and unregistering are O(1) and never allocate, and objects are visited in the order they were created. Each depth also has a version
+  // number that changes whenever anything about how that depth looks changes, so a renderer can tell when a cached drawing of it is stale.
+  // The registry also counts the world's ticks, so objects can tell where they were before the current tick and be drawn between the two
+class GraphObjectRegistry
+{
+  public:
+	static const int NUM_DEPTHS = 4;
+
+	class iterator
+	{
+	  public:
+		explicit iterator(GraphObject* obj)
+		 : m_obj(obj)
+		{
+		}
+
+		GraphObject* operator*() const
+		{
+			return m_obj;
+		}
+
+		iterator& operator++();
+
+		iterator operator++(int)
+		{
+			iterator old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return m_obj == other.m_obj;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return m_obj != other.m_obj;
+		}
+
+	  private:
+		GraphObject* m_obj;
+	};
+
+	class Layer
+	{
+	  public:
+		Layer()
+		 : m_head(nullptr), m_tail(nullptr), m_size(0), m_version(0), m_touchedTick(0)
+		{
+		}
+
+		unsigned long version() const
+		{
+			return m_version;
+		}
+
+		iterator begin() const
+		{
+			return iterator(m_head);
+		}
+
+		iterator end() const
+		{
+			return iterator(nullptr);
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+
+		bool empty() const
+		{
+			return m_size == 0;
+		}
+
+	  private:
+		friend class GraphObjectRegistry;
+
+		GraphObject* m_head;
+		GraphObject* m_tail;
+		size_t		 m_size;
+		unsigned long m_version;
+		unsigned long m_touchedTick;	// The last tick during which the version changed
+	};
+
+	GraphObjectRegistry()
+	 : m_tick(0)
+	{
+	}
+
+	  // Called by the world at the start of each tick
+	void beginTick()
+	{
+		m_tick++;
+	}
+
+	unsigned long currentTick() const
+	{
+		return m_tick;
+	}
+
+	void insert(GraphObject* obj, int depth);
+	void erase(GraphObject* obj, int depth);
+
+	  // Note that an object at the given depth has moved or otherwise changed its appearance
+	void touch(int depth)
+	{
+		Layer& layer = m_layers[layerFor(depth)];
+		layer.m_version++;
+		layer.m_touchedTick = m_tick;
+	}
+
+	  // True if nothing at the given depth changed during the latest tick, so the depth looks the same however far between ticks it is drawn
+	bool settled(int depth) const
+	{
+		return m_layers[layerFor(depth)].m_touchedTick != m_tick;
+	}
+
+	const Layer& objects(int layer) const
+	{
+		return m_layers[layerFor(layer)];
+	}
+
+  private:
+	Layer m_layers[NUM_DEPTHS];
+	unsigned long m_tick;
+
+	static int layerFor(int depth)
+	{
+		if (depth < NUM_DEPTHS)
+			return depth;
+		else
+			return 0;
+	}
+};
 
 class GraphObject
 {
@@ -18,26 +157,27 @@ class GraphObject
 	static const int up = 90;
 	static const int down = 270;
 
-	GraphObject(int imageID, int startX, int startY, int dir = 0, int depth = 0, double size = 1.0)
-	 : m_imageID(imageID), m_visible(true), m_x(startX), m_y(startY),
-	   m_destX(startX), m_destY(startY), m_brightness(1.0),
+	GraphObject(GraphObjectRegistry& registry, int imageID, int startX, int startY, int dir = 0, int depth = 0, double size = 1.0)
+	 : m_registry(registry), m_prevInLayer(nullptr), m_nextInLayer(nullptr), m_imageID(imageID), m_visible(true),
+	   m_destX(startX), m_destY(startY), m_prevX(startX), m_prevY(startY), m_moveTick(registry.currentTick() - 1), m_brightness(1.0),
 	   m_animationNumber(0), m_direction(dir), m_depth(depth), m_size(size)
 	{
 		if (m_size <= 0)
 			m_size = 1;
 
-		getGraphObjects(m_depth).insert(this);
+		m_registry.insert(this, m_depth);
 		setVisible(true);
 	}
 
 	virtual ~GraphObject()
 	{
-		getGraphObjects(m_depth).erase(this);
+		m_registry.erase(this, m_depth);
 	}
 
 	void setVisible(bool shouldIDisplay)
 	{
 		m_visible = shouldIDisplay;
+		m_registry.touch(m_depth);
 	}
 
 	void setBrightness(double brightness)
@@ -59,6 +199,13 @@ class GraphObject
 
 	virtual void moveTo(double x, double y)
 	{
+		if (m_moveTick != m_registry.currentTick())
+		{
+			  // First move this tick: remember where the tick started, to draw the object in between
+			m_prevX = m_destX;
+			m_prevY = m_destY;
+			m_moveTick = m_registry.currentTick();
+		}
 		m_destX = x;
 		m_destY = y;
 		increaseAnimationNumber();
@@ -90,17 +237,19 @@ class GraphObject
 		return m_direction;
 	}
 
-	void setDirection(int d)
+	virtual void setDirection(int d)
 	{
 		while (d < 0)
 			d += 360;
 
 		m_direction = d % 360;
+		m_registry.touch(m_depth);
 	}
 
 	void setSize(double size)
 	{
 		m_size = size;
+		m_registry.touch(m_depth);
 	}
 
 	double getSize() const
@@ -131,72 +280,96 @@ class GraphObject
 		return m_animationNumber;
 	}
 
-	void getAnimationLocation(double& x, double& y) const
-	{
-		x = m_x;
-		y = m_y;
-	}
-
-	void animate()
-	{
-		m_x = m_destX;
-		m_y = m_destY;
-//		moveALittle(m_x, m_destX);
-	//	moveALittle(m_y, m_destY);
-	}
-
-	static std::set<GraphObject*>& getGraphObjects(int layer)
+	  // Where the object was at the start of the latest tick, so it can be drawn moving from there to where it is now. An object that
+	  // didn't move during that tick is simply where it is
+	void getTickStartLocation(double& x, double& y) const
 	{
-		static std::set<GraphObject*> graphObjects[NUM_DEPTHS];
-		if (layer < NUM_DEPTHS)
-			return graphObjects[layer];
+		if (m_moveTick == m_registry.currentTick())
+		{
+			x = m_prevX;
+			y = m_prevY;
+		}
 		else
-			return graphObjects[0];		// empty;
+		{
+			x = m_destX;
+			y = m_destY;
+		}
 	}
 
 	void increaseAnimationNumber()
 	{
 		m_animationNumber++;
+		m_registry.touch(m_depth);  // Every move comes through here
 	}
 
-
-  private:
-	friend class GameController;
 	int getID() const
 	{
 		return m_imageID;
 	}
 
+  private:
+	friend class GameController;
+	friend class GraphObjectRegistry;
+
   private:
 	  // Prevent copying or assigning GraphObjects
 	GraphObject(const GraphObject&);
 	GraphObject& operator=(const GraphObject&);
 
-	static const int NUM_DEPTHS = 4;
+	static const int NUM_DEPTHS = GraphObjectRegistry::NUM_DEPTHS;
+	GraphObjectRegistry& m_registry;
+	GraphObject* m_prevInLayer;		// Links for the registry's list of objects at this depth
+	GraphObject* m_nextInLayer;
 	int		m_imageID;
 	bool	m_visible;
-	double	m_x;
-	double	m_y;
 	double	m_destX;
 	double	m_destY;
+	double	m_prevX;		// Where the object was at the start of tick m_moveTick
+	double	m_prevY;
+	unsigned long m_moveTick;
 	double	m_brightness;
 	int     m_animationNumber;
 	int     m_direction;
 	int		m_depth;
 	double	m_size;
+};
 
-	void moveALittle(double& from, double& to)
-	{
-		static const double DISTANCE = 1.0/ANIMATION_POSITIONS_PER_TICK;
-		if (to - from >= DISTANCE)
-			from += DISTANCE;
-		else if (from - to >= DISTANCE)
-			from -= DISTANCE;
-		else
-			from = to;
-	}
-
+inline GraphObjectRegistry::iterator& GraphObjectRegistry::iterator::operator++()
+{
+	m_obj = m_obj->m_nextInLayer;
+	return *this;
+}
 
-};
+inline void GraphObjectRegistry::insert(GraphObject* obj, int depth)
+{
+	Layer& layer = m_layers[layerFor(depth)];
+	obj->m_prevInLayer = layer.m_tail;
+	obj->m_nextInLayer = nullptr;
+	if (layer.m_tail != nullptr)
+		layer.m_tail->m_nextInLayer = obj;
+	else
+		layer.m_head = obj;
+	layer.m_tail = obj;
+	layer.m_size++;
+	layer.m_version++;
+	layer.m_touchedTick = m_tick;
+}
+
+inline void GraphObjectRegistry::erase(GraphObject* obj, int depth)
+{
+	Layer& layer = m_layers[layerFor(depth)];
+	if (obj->m_prevInLayer != nullptr)
+		obj->m_prevInLayer->m_nextInLayer = obj->m_nextInLayer;
+	else
+		layer.m_head = obj->m_nextInLayer;
+	if (obj->m_nextInLayer != nullptr)
+		obj->m_nextInLayer->m_prevInLayer = obj->m_prevInLayer;
+	else
+		layer.m_tail = obj->m_prevInLayer;
+	obj->m_prevInLayer = obj->m_nextInLayer = nullptr;
+	layer.m_size--;
+	layer.m_version++;
+	layer.m_touchedTick = m_tick;
+}
 
 #endif // GRAPHOBJ_H_
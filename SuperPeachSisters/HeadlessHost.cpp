@@ -0,0 +1,92 @@
+#include "HeadlessHost.h"
+#include "GameWorld.h"
+#include "GameConstants.h"
+#include <ostream>
+#include <iomanip>
+
+void HeadlessHost::attach(GameWorld* gw)
+{
+	gw->setController(this);
+	m_gw = gw;
+	m_quit = false;
+	m_cursor = InputScript::Cursor();
+}
+
+HeadlessHost::Result HeadlessHost::run(GameWorld* gw, long maxTicks)
+{
+	attach(gw);
+
+	Result result;
+	long startTick = gw->getTickCount();
+	int status = gw->init();
+	for (;;)
+	{
+		if (status == GWSTATUS_LEVEL_ERROR)
+		{
+			result.outcome = level_error;
+			break;
+		}
+		if (status == GWSTATUS_PLAYER_WON)
+		{
+			result.outcome = won;
+			break;
+		}
+		if (m_quit)
+		{
+			result.outcome = quit;
+			break;
+		}
+		if (gw->getTickCount() - startTick >= maxTicks)
+		{
+			result.outcome = tick_limit;
+			break;
+		}
+
+		status = gw->tick();
+		if (m_hashTrace != nullptr)
+			*m_hashTrace << gw->getTickCount() << ' ' << std::hex << std::setw(16) << std::setfill('0') << gw->stateHash() << std::dec << '\n';
+		if (status == GWSTATUS_PLAYER_DIED)
+		{
+			if (gw->isGameOver())
+			{
+				result.outcome = lost;
+				break;
+			}
+			status = gw->restartLevel();
+		}
+		else if (status == GWSTATUS_FINISHED_LEVEL)
+		{
+			gw->advanceToNextLevel();
+			gw->cleanUp();
+			status = gw->init();
+		}
+	}
+
+	result.ticks = gw->getTickCount() - startTick;
+	result.score = gw->getScore();
+	result.level = gw->getLevel();
+	result.lives = gw->getLives();
+	gw->cleanUp();
+	m_gw = nullptr;
+	return result;
+}
+
+bool HeadlessHost::getLastKey(int& value)
+{
+	if (m_script == nullptr || m_gw == nullptr)
+		return false;
+	return m_cursor.keyAt(*m_script, m_gw->getTickCount(), value);
+}
+
+const char* HeadlessHost::outcomeName(Outcome outcome)
+{
+	switch (outcome)
+	{
+	case won:			return "won";
+	case lost:			return "lost";
+	case quit:			return "quit";
+	case level_error:	return "level_error";
+	case tick_limit:	return "tick_limit";
+	}
+	return "unknown";
+}
@@ -0,0 +1,63 @@
+#ifndef HEADLESSHOST_H_
+#define HEADLESSHOST_H_
+
+#include "GameHost.h"
+#include "InputScript.h"
+#include <string>
+#include <iosfwd>
+
+class GameWorld;
+
+// Runs a GameWorld without a window: keys come from an InputScript, sounds and status text are discarded, and the world is stepped through
+// init()/move()/cleanUp() as fast as the CPU allows. The level transitions mirror GameController's, minus the "Press Enter" prompts
+class HeadlessHost : public GameHost
+{
+public:
+	enum Outcome {
+		won, lost, quit, level_error, tick_limit
+	};
+
+	struct Result
+	{
+		Outcome outcome;
+		long	ticks;
+		int		score;
+		int		level;
+		int		lives;
+	};
+
+	HeadlessHost(const InputScript* script = nullptr)
+	 : m_script(script), m_gw(nullptr), m_quit(false), m_hashTrace(nullptr)
+	{
+	}
+
+	  // Have run() write a line with the tick number and the world's stateHash() after every tick, so that two runs of the same replay
+	  // (i.e. by different builds) can be compared to find the exact tick where they diverge. The caller keeps ownership of trace
+	void setHashTrace(std::ostream* trace)
+	{
+		m_hashTrace = trace;
+	}
+
+	  // Play gw from its current level until the game ends or maxTicks more ticks have run. The caller keeps ownership of gw
+	Result run(GameWorld* gw, long maxTicks);
+
+	  // Become gw's host without driving it, for callers that want to step the world themselves
+	void attach(GameWorld* gw);
+
+	virtual bool getLastKey(int& value);
+	virtual void playSound(int) {}
+	virtual void setGameStatText(std::string) {}
+	virtual void setMsPerTick(int) {}
+	virtual void quitGame() { m_quit = true; }
+
+	static const char* outcomeName(Outcome outcome);
+
+private:
+	const InputScript*	m_script;
+	InputScript::Cursor m_cursor;
+	GameWorld*			m_gw;
+	bool				m_quit;
+	std::ostream*		m_hashTrace;
+};
+
+#endif // HEADLESSHOST_H_
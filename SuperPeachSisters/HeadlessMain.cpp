@@ -0,0 +1,122 @@
+#include "HeadlessHost.h"
+#include "InputScript.h"
+#include "GameWorld.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+using namespace std;
+
+  // Plays the game without a window, e.g. on a build machine with no display:
+  //
+  //   SuperPeachHeadless [--assets dir] [--level n] [--ticks n] [--input script] [--seed n] [--record file] [--hash-trace file]
+  //
+  // The world starts at the given level (1 by default) and runs until the game is won or lost, the script quits, or the tick limit is hit.
+  // The same seed (0 by default) and script always play out the same way. The script may be a text script or a recording made by the game
+  // or by --record, in which case the recording's seed and starting level are used unless --seed or --level say otherwise. Replays run as
+  // fast as the CPU allows. --hash-trace writes the world's state hash after every tick, one "tick hash" line each; diffing the traces of
+  // two builds replaying the same script shows the first tick where they disagree.
+
+GameWorld* createStudentWorld(string assetPath = "");
+
+static void usage()
+{
+	cerr << "usage: SuperPeachHeadless [--assets dir] [--level n] [--ticks n] [--input script] [--seed n] [--record file] [--hash-trace file]"
+		 << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	string assetPath = "Assets";
+	int level = 0;
+	long maxTicks = 100000;
+	string inputFile;
+	unsigned long long seed = 0;
+	bool seedGiven = false;
+	string recordFile;
+	string hashTraceFile;
+
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (k + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+		if (arg == "--assets")
+			assetPath = argv[++k];
+		else if (arg == "--level")
+			level = atoi(argv[++k]);
+		else if (arg == "--ticks")
+			maxTicks = atol(argv[++k]);
+		else if (arg == "--input")
+			inputFile = argv[++k];
+		else if (arg == "--seed")
+		{
+			seed = strtoull(argv[++k], nullptr, 10);
+			seedGiven = true;
+		}
+		else if (arg == "--record")
+			recordFile = argv[++k];
+		else if (arg == "--hash-trace")
+			hashTraceFile = argv[++k];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	InputScript script;
+	if (!inputFile.empty() && !script.load(inputFile))
+	{
+		cerr << "Cannot read input script " << inputFile << endl;
+		return 1;
+	}
+	if (!seedGiven)
+		seed = script.seed();
+	if (level == 0)
+		level = script.startLevel();
+
+	GameWorld* gw = createStudentWorld(assetPath);
+	gw->setSeed(seed);
+	for (int k = 1; k < level; k++)
+		gw->advanceToNextLevel();
+
+	InputScript recording;
+	recording.setSeed(seed);
+	recording.setStartLevel(level);
+	if (!recordFile.empty())
+		gw->setRecorder(&recording);
+
+	ofstream hashTrace;
+	if (!hashTraceFile.empty())
+	{
+		hashTrace.open(hashTraceFile);
+		if (!hashTrace)
+		{
+			cerr << "Cannot write hash trace " << hashTraceFile << endl;
+			return 1;
+		}
+	}
+
+	HeadlessHost host(&script);
+	if (hashTrace.is_open())
+		host.setHashTrace(&hashTrace);
+	HeadlessHost::Result result = host.run(gw, maxTicks);
+	delete gw;
+
+	if (!recordFile.empty() && !recording.saveRecording(recordFile))
+	{
+		cerr << "Cannot write recording " << recordFile << endl;
+		return 1;
+	}
+
+	cout << "outcome: " << HeadlessHost::outcomeName(result.outcome) << endl;
+	cout << "ticks: " << result.ticks << endl;
+	cout << "score: " << result.score << endl;
+	cout << "level: " << result.level << endl;
+	cout << "lives: " << result.lives << endl;
+	return result.outcome == HeadlessHost::level_error ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+#include "InputScript.h"
+#include "GameConstants.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+const char InputScript::RECORDING_MAGIC[4] = { 'S', 'P', 'I', 'R' };
+
+static void writeVarint(ostream& out, uint64_t value)
+{
+	do
+	{
+		unsigned char byte = value & 0x7f;
+		value >>= 7;
+		out.put(static_cast<char>(value != 0 ? byte | 0x80 : byte));
+	} while (value != 0);
+}
+
+static bool readVarint(istream& in, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int c = in.get();
+		if (c == EOF)
+			return false;
+		value |= static_cast<uint64_t>(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+			return true;
+	}
+	return false;  // more than 64 bits' worth
+}
+
+void InputScript::add(long tick, int key)
+{
+	  // Keep the events sorted by tick; events for the same tick stay in the order they were added
+	Event e = { tick, key };
+	auto pos = upper_bound(m_events.begin(), m_events.end(), e,
+						   [](const Event& a, const Event& b) { return a.tick < b.tick; });
+	m_events.insert(pos, e);
+}
+
+bool InputScript::loadText(string filename)
+{
+	ifstream scriptFile(filename);
+	if (!scriptFile)
+		return false;
+
+	string line;
+	while (getline(scriptFile, line))
+	{
+		istringstream iss(line);
+		long tick;
+		string name;
+		if (!(iss >> tick))
+		{
+			  // blank and comment lines are fine, anything else is not
+			iss.clear();
+			char c;
+			if (iss >> c && c != '#')
+				return false;
+			continue;
+		}
+		int key;
+		if (!(iss >> name) || !parseKey(name, key))
+			return false;
+		add(tick, key);
+	}
+	return true;
+}
+
+bool InputScript::saveRecording(string filename) const
+{
+	ofstream out(filename, ios::binary);
+	if (!out)
+		return false;
+
+	out.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	out.put(static_cast<char>(RECORDING_VERSION));
+	for (int k = 0; k < 8; k++)
+		out.put(static_cast<char>((m_seed >> (8 * k)) & 0xff));
+	writeVarint(out, m_startLevel);
+	writeVarint(out, m_events.size());
+	long lastTick = 0;
+	for (size_t k = 0; k < m_events.size(); k++)
+	{
+		writeVarint(out, m_events[k].tick - lastTick);
+		writeVarint(out, m_events[k].key);
+		lastTick = m_events[k].tick;
+	}
+	return static_cast<bool>(out);
+}
+
+bool InputScript::loadRecording(string filename)
+{
+	ifstream in(filename, ios::binary);
+	if (!in)
+		return false;
+
+	char magic[sizeof(RECORDING_MAGIC)];
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0)
+		return false;
+	if (in.get() != RECORDING_VERSION)
+		return false;
+	uint64_t seed = 0;
+	for (int k = 0; k < 8; k++)
+	{
+		int c = in.get();
+		if (c == EOF)
+			return false;
+		seed |= static_cast<uint64_t>(c) << (8 * k);
+	}
+	uint64_t startLevel;
+	uint64_t count;
+	if (!readVarint(in, startLevel) || !readVarint(in, count))
+		return false;
+
+	vector<Event> events;
+	long tick = 0;
+	for (uint64_t k = 0; k < count; k++)
+	{
+		uint64_t delta;
+		uint64_t key;
+		if (!readVarint(in, delta) || !readVarint(in, key))
+			return false;
+		tick += static_cast<long>(delta);
+		Event e = { tick, static_cast<int>(key) };
+		events.push_back(e);  // already in tick order
+	}
+
+	m_events.insert(m_events.end(), events.begin(), events.end());
+	m_seed = seed;
+	m_startLevel = static_cast<int>(startLevel);
+	return true;
+}
+
+bool InputScript::load(string filename)
+{
+	ifstream in(filename, ios::binary);
+	char magic[sizeof(RECORDING_MAGIC)];
+	if (in.read(magic, sizeof(magic)) && memcmp(magic, RECORDING_MAGIC, sizeof(magic)) == 0)
+		return loadRecording(filename);
+	return loadText(filename);
+}
+
+InputScript InputScript::makeWandering(uint64_t seed, long ticks)
+{
+	static const int keys[] = { KEY_PRESS_RIGHT, KEY_PRESS_RIGHT, KEY_PRESS_RIGHT, KEY_PRESS_UP, KEY_PRESS_UP, KEY_PRESS_SPACE, KEY_PRESS_LEFT };
+	InputScript script;
+	uint64_t state = seed;
+	for (long t = 0; t < ticks; t++)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		unsigned int r = static_cast<unsigned int>(state >> 33) % 10;
+		if (r < sizeof(keys) / sizeof(keys[0]))
+			script.m_events.push_back(Event{ t, keys[r] });  // already in tick order
+	}
+	return script;
+}
+
+bool InputScript::parseKey(string name, int& key)
+{
+	static const struct { const char* name; int key; } names[] = {
+		{ "left", KEY_PRESS_LEFT },
+		{ "right", KEY_PRESS_RIGHT },
+		{ "up", KEY_PRESS_UP },
+		{ "down", KEY_PRESS_DOWN },
+		{ "space", KEY_PRESS_SPACE },
+		{ "tab", KEY_PRESS_TAB },
+		{ "enter", KEY_PRESS_ENTER },
+		{ "escape", KEY_PRESS_ESCAPE },
+	};
+
+	for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++)
+	{
+		if (name == names[k].name)
+		{
+			key = names[k].key;
+			return true;
+		}
+	}
+	if (name.size() == 1)
+	{
+		key = static_cast<unsigned char>(name[0]);
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,93 @@
+#ifndef INPUTSCRIPT_H_
+#define INPUTSCRIPT_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// A fixed sequence of key presses, each tied to the tick (see GameWorld::getTickCount()) during which the world should see it. The script
+// itself is read-only once built, so a single script can drive any number of worlds; each reader keeps its own Cursor into it.
+//
+// The text format has one "<tick> <key>" pair per line, where key is one of left, right, up, down, space, tab, enter, escape or a single
+// character. Blank lines and lines starting with # are ignored, and the pairs may appear in any order.
+//
+// A script can also be a recording of a session (see GameWorld::setRecorder()), which is saved in a compact binary format together with the
+// world's seed and starting level, so that replaying it reproduces the session exactly:
+//
+//   "SPIR", version byte, seed (8 bytes, little-endian), start level, event count, then per event: tick delta, key
+//
+// where everything after the seed is an unsigned LEB128 varint and each tick delta is relative to the previous event's tick
+class InputScript
+{
+public:
+	InputScript()
+	 : m_seed(0), m_startLevel(1)
+	{
+	}
+
+	struct Event
+	{
+		long tick;
+		int  key;
+	};
+
+	class Cursor
+	{
+	public:
+		Cursor()
+		 : m_next(0)
+		{
+		}
+
+		  // Return the key for the given tick, if there is one. Ticks must be asked for in non-decreasing order
+		bool keyAt(const InputScript& script, long tick, int& key)
+		{
+			const std::vector<Event>& events = script.m_events;
+			while (m_next < events.size() && events[m_next].tick < tick)
+				m_next++;
+			if (m_next < events.size() && events[m_next].tick == tick)
+			{
+				key = events[m_next++].key;
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		size_t m_next;
+	};
+
+	void add(long tick, int key);
+	bool loadText(std::string filename);
+	bool loadRecording(std::string filename);
+	bool saveRecording(std::string filename) const;
+
+	  // Load either format, telling them apart by the recording's magic number
+	bool load(std::string filename);
+
+	  // Only recordings carry these; for a text script they keep their defaults
+	uint64_t seed() const { return m_seed; }
+	void setSeed(uint64_t seed) { m_seed = seed; }
+	int startLevel() const { return m_startLevel; }
+	void setStartLevel(int level) { m_startLevel = level; }
+
+	const std::vector<Event>& events() const
+	{
+		return m_events;
+	}
+
+	static bool parseKey(std::string name, int& key);
+
+	  // A script of the given length in which Peach wanders the level: mostly running right, with some jumping, firing and backtracking
+	static InputScript makeWandering(uint64_t seed, long ticks);
+
+private:
+	std::vector<Event> m_events;  // sorted by tick
+	uint64_t	m_seed;
+	int			m_startLevel;
+
+	static const char RECORDING_MAGIC[4];
+	static const unsigned char RECORDING_VERSION = 1;
+};
+
+#endif // INPUTSCRIPT_H_
@@ -0,0 +1,65 @@
+#include "CompiledLevel.h"
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+  // Compiles text level files into the binary form the game loads:
+  //
+  //   SuperPeachLevelCompiler [--out file] level.txt...
+  //
+  // Each levelNN.txt is written as levelNN.lvb beside it, or to the --out file if just one level is given. The game compiles stale or
+  // missing binaries itself when it loads a level, so this is only needed to ship binaries ahead of time, or to check a level by hand.
+
+static void usage()
+{
+	cerr << "usage: SuperPeachLevelCompiler [--out file] level.txt..." << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	string outFile;
+	vector<string> textFiles;
+
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (arg == "--out")
+		{
+			if (k + 1 >= argc)
+			{
+				usage();
+				return 1;
+			}
+			outFile = argv[++k];
+		}
+		else
+			textFiles.push_back(arg);
+	}
+	if (textFiles.empty() || (!outFile.empty() && textFiles.size() > 1))
+	{
+		usage();
+		return 1;
+	}
+
+	int failures = 0;
+	for (size_t k = 0; k < textFiles.size(); k++)
+	{
+		string binaryFile = outFile.empty() ? CompiledLevel::binaryPathFor(textFiles[k]) : outFile;
+		switch (CompiledLevel::compileFile(textFiles[k], binaryFile))
+		{
+		case Level::load_success:
+			cout << textFiles[k] << " -> " << binaryFile << endl;
+			break;
+		case Level::load_fail_bad_format:
+			cerr << textFiles[k] << ": error in level data file encoding" << endl;
+			failures++;
+			break;
+		case Level::load_fail_file_not_found:
+			cerr << textFiles[k] << ": cannot read it, or cannot write " << binaryFile << endl;
+			failures++;
+			break;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
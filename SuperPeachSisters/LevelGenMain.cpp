@@ -0,0 +1,89 @@
+#include "LevelGenerator.h"
+#include "Level.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+using namespace std;
+
+  // Writes a procedurally generated level file:
+  //
+  //   SuperPeachLevelGen --out file [--seed n] [--width n] [--height n] [--blocks d] [--pipes d] [--goodies d]
+  //                      [--goombas d] [--koopas d] [--piranhas d] [--mario]
+  //
+  // Densities are probabilities between 0 and 1 (see LevelGenerator::Params). Levels of the size the game loads are checked with the
+  // Level loader after being written.
+
+static void usage()
+{
+	cerr << "usage: SuperPeachLevelGen --out file [--seed n] [--width n] [--height n] [--blocks d] [--pipes d] [--goodies d]" << endl
+		 << "                          [--goombas d] [--koopas d] [--piranhas d] [--mario]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	LevelGenerator::Params params;
+	string outFile;
+
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (arg == "--mario")
+		{
+			params.mario = true;
+			continue;
+		}
+		if (k + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+		string value = argv[++k];
+		if (arg == "--out")
+			outFile = value;
+		else if (arg == "--seed")
+			params.seed = strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--width")
+			params.width = atoi(value.c_str());
+		else if (arg == "--height")
+			params.height = atoi(value.c_str());
+		else if (arg == "--blocks")
+			params.blockDensity = atof(value.c_str());
+		else if (arg == "--pipes")
+			params.pipeDensity = atof(value.c_str());
+		else if (arg == "--goodies")
+			params.goodieDensity = atof(value.c_str());
+		else if (arg == "--goombas")
+			params.goombaDensity = atof(value.c_str());
+		else if (arg == "--koopas")
+			params.koopaDensity = atof(value.c_str());
+		else if (arg == "--piranhas")
+			params.piranhaDensity = atof(value.c_str());
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (outFile.empty())
+	{
+		usage();
+		return 1;
+	}
+
+	if (!LevelGenerator::write(params, outFile))
+	{
+		cerr << "Cannot generate " << outFile << endl;
+		return 1;
+	}
+
+	if (params.width == GRID_WIDTH && params.height == GRID_HEIGHT)
+	{
+		Level lev("");
+		if (lev.loadLevel(outFile) != Level::load_success)
+		{
+			cerr << "Generated level " << outFile << " does not load!" << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
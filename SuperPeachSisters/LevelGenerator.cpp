@@ -0,0 +1,101 @@
+#include "LevelGenerator.h"
+#include <fstream>
+#include <random>
+using namespace std;
+
+  // Helpers built straight on the engine's output rather than on <random>'s distributions, whose results differ between standard libraries,
+  // so that a seed produces the same level everywhere
+static double uniform(mt19937_64& rng)
+{
+	return (rng() >> 11) * (1.0 / 9007199254740992.0);  // 53 random bits in [0, 1)
+}
+
+static bool chance(mt19937_64& rng, double p)
+{
+	return uniform(rng) < p;
+}
+
+  // Terrain that an enemy or pipe can stand on
+static bool isSolid(char c)
+{
+	return c == '#' || c == '*' || c == '^' || c == '%' || c == 'I';
+}
+
+bool LevelGenerator::generate(const Params& params, vector<string>& rows)
+{
+	int width = params.width;
+	int height = params.height;
+	if (width < 4 || height < 4)  // the border plus room for Peach, the goal and something to stand on
+		return false;
+
+	mt19937_64 rng(params.seed);
+
+	  // grid[gy][gx], with gy = 0 at the bottom just like the Level loader
+	vector<string> grid(height, string(width, ' '));
+	for (int gx = 0; gx < width; gx++)
+		grid[0][gx] = grid[height - 1][gx] = '#';
+	for (int gy = 0; gy < height; gy++)
+		grid[gy][0] = grid[gy][width - 1] = '#';
+
+	  // Platforms every few rows, made of runs of blocks, some of which hold goodies
+	for (int gy = PLATFORM_SPACING; gy < height - 2; gy += PLATFORM_SPACING)
+	{
+		for (int gx = 1; gx < width - 1; gx++)
+		{
+			if (!chance(rng, params.blockDensity))
+				continue;
+			char c = '#';
+			if (chance(rng, params.goodieDensity))
+			{
+				static const char goodies[] = { '*', '^', '%' };
+				c = goodies[rng() % 3];
+			}
+			grid[gy][gx] = c;
+		}
+	}
+
+	  // Peach starts in the bottom left corner and the goal sits in the bottom right one
+	int peachX = 1;
+	int goalX = width - 2;
+	grid[1][peachX] = '@';
+	grid[1][goalX] = (params.mario ? 'M' : 'F');
+
+	  // Pipes and enemies go on empty cells that have something solid right below them
+	for (int gy = 1; gy < height - 1; gy++)
+	{
+		for (int gx = 1; gx < width - 1; gx++)
+		{
+			if (grid[gy][gx] != ' ' || !isSolid(grid[gy - 1][gx]))
+				continue;
+			if (gy == 1 && (gx == peachX + 1 || gx == goalX - 1))  // keep Peach and the goal from being boxed in
+				continue;
+
+			double r = uniform(rng);
+			if ((r -= params.pipeDensity) < 0)
+				grid[gy][gx] = 'I';
+			else if ((r -= params.goombaDensity) < 0)
+				grid[gy][gx] = 'G';
+			else if ((r -= params.koopaDensity) < 0)
+				grid[gy][gx] = 'K';
+			else if ((r -= params.piranhaDensity) < 0)
+				grid[gy][gx] = 'P';
+		}
+	}
+
+	rows.assign(grid.rbegin(), grid.rend());
+	return true;
+}
+
+bool LevelGenerator::write(const Params& params, string filename)
+{
+	vector<string> rows;
+	if (!generate(params, rows))
+		return false;
+
+	ofstream levelFile(filename);
+	if (!levelFile)
+		return false;
+	for (size_t k = 0; k < rows.size(); k++)
+		levelFile << rows[k] << '\n';
+	return static_cast<bool>(levelFile);
+}
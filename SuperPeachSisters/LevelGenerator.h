@@ -0,0 +1,42 @@
+#ifndef LEVELGENERATOR_H_
+#define LEVELGENERATOR_H_
+
+#include "GameConstants.h"
+#include <string>
+#include <vector>
+
+// Builds random but valid levels for stress and scale testing: the edges are all blocks, there is exactly one Peach, and exactly one Flag
+// or Mario. Everything else is controlled by per-cell densities, and the same parameters (including the seed) always produce the same level.
+// The size defaults to what the Level loader accepts (GRID_WIDTH x GRID_HEIGHT), but any size can be generated
+class LevelGenerator
+{
+public:
+	struct Params
+	{
+		int					width;
+		int					height;
+		unsigned long long	seed;
+		double				blockDensity;	// chance that a platform row cell is a block
+		double				pipeDensity;	// chance that a standing spot gets a pipe
+		double				goodieDensity;	// chance that a block holds a goodie (split evenly between star, mushroom and flower)
+		double				goombaDensity;	// chance that a standing spot gets each kind of enemy
+		double				koopaDensity;
+		double				piranhaDensity;
+		bool				mario;			// finish with Mario (the final level) rather than a Flag
+
+		Params()
+		 : width(GRID_WIDTH), height(GRID_HEIGHT), seed(1), blockDensity(0.6), pipeDensity(0.05), goodieDensity(0.05),
+		   goombaDensity(0.05), koopaDensity(0.05), piranhaDensity(0.02), mario(false)
+		{
+		}
+	};
+
+	  // Rows of the level file, top row first; false if the size is too small to hold a level
+	static bool generate(const Params& params, std::vector<std::string>& rows);
+	static bool write(const Params& params, std::string filename);
+
+private:
+	static const int PLATFORM_SPACING = 4;	// rows between platforms, which leaves room to jump between them
+};
+
+#endif // LEVELGENERATOR_H_
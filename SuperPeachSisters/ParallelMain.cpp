@@ -0,0 +1,109 @@
+#include "ParallelRunner.h"
+#include "InputScript.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+
+  // Plays many seeded worlds at once, e.g. for level QA:
+  //
+  //   SuperPeachParallel [--assets dir] [--worlds n] [--threads n] [--ticks n] [--level n] [--seed n] [--input script]
+  //
+  // World k (counting from 0) is seeded with seed + k. Unless --input gives one script for every world to follow, each world gets its own
+  // wandering script from the same seed. Prints how the games ended and the combined tick throughput.
+
+static void usage()
+{
+	cerr << "usage: SuperPeachParallel [--assets dir] [--worlds n] [--threads n] [--ticks n] [--level n] [--seed n] [--input script]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	string assetPath = "Assets";
+	int numWorlds = 64;
+	unsigned numThreads = 0;
+	long maxTicks = 5000;
+	int level = 1;
+	unsigned long long seed = 1;
+	string inputFile;
+
+	for (int k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		if (k + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+		if (arg == "--assets")
+			assetPath = argv[++k];
+		else if (arg == "--worlds")
+			numWorlds = atoi(argv[++k]);
+		else if (arg == "--threads")
+			numThreads = static_cast<unsigned>(atoi(argv[++k]));
+		else if (arg == "--ticks")
+			maxTicks = atol(argv[++k]);
+		else if (arg == "--level")
+			level = atoi(argv[++k]);
+		else if (arg == "--seed")
+			seed = strtoull(argv[++k], nullptr, 10);
+		else if (arg == "--input")
+			inputFile = argv[++k];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	InputScript sharedScript;
+	if (!inputFile.empty() && !sharedScript.load(inputFile))
+	{
+		cerr << "Cannot read input script " << inputFile << endl;
+		return 1;
+	}
+
+	vector<InputScript> scripts(inputFile.empty() ? numWorlds : 0);
+	vector<ParallelRunner::Job> jobs;
+	for (int k = 0; k < numWorlds; k++)
+	{
+		ParallelRunner::Job job;
+		job.assetPath = assetPath;
+		job.seed = seed + k;
+		job.startLevel = level;
+		job.maxTicks = maxTicks;
+		if (inputFile.empty())
+		{
+			scripts[k] = InputScript::makeWandering(job.seed, maxTicks);
+			job.script = &scripts[k];
+		}
+		else
+			job.script = &sharedScript;
+		jobs.push_back(job);
+	}
+
+	ParallelRunner runner(numThreads);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<HeadlessHost::Result> results = runner.run(jobs);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	long totalTicks = 0;
+	map<string, int> outcomes;
+	for (size_t k = 0; k < results.size(); k++)
+	{
+		totalTicks += results[k].ticks;
+		outcomes[HeadlessHost::outcomeName(results[k].outcome)]++;
+	}
+
+	cout << "worlds: " << numWorlds << endl;
+	cout << "threads: " << runner.numThreads() << endl;
+	cout << "seconds: " << seconds << endl;
+	cout << "ticks: " << totalTicks << endl;
+	cout << "ticks_per_sec: " << (seconds > 0 ? totalTicks / seconds : 0) << endl;
+	for (map<string, int>::const_iterator p = outcomes.begin(); p != outcomes.end(); p++)
+		cout << "outcome " << p->first << ": " << p->second << endl;
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "ParallelRunner.h"
+#include "GameWorld.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+using namespace std;
+
+GameWorld* createStudentWorld(string assetPath = "");
+
+ParallelRunner::ParallelRunner(unsigned numThreads)
+ : m_numThreads(numThreads)
+{
+	if (m_numThreads == 0)
+		m_numThreads = max(1u, thread::hardware_concurrency());
+}
+
+HeadlessHost::Result ParallelRunner::runOne(const Job& job)
+{
+	GameWorld* gw = createStudentWorld(job.assetPath);
+	gw->setSeed(job.seed);
+	for (int k = 1; k < job.startLevel; k++)
+		gw->advanceToNextLevel();
+
+	HeadlessHost host(job.script);
+	HeadlessHost::Result result = host.run(gw, job.maxTicks);
+	delete gw;
+	return result;
+}
+
+vector<HeadlessHost::Result> ParallelRunner::run(const vector<Job>& jobs) const
+{
+	vector<HeadlessHost::Result> results(jobs.size());
+
+	  // Workers claim jobs one at a time, so a long game on one thread doesn't hold up the others; each result has its own slot
+	atomic<size_t> nextJob(0);
+	auto worker = [&]() {
+		for (size_t k = nextJob++; k < jobs.size(); k = nextJob++)
+			results[k] = runOne(jobs[k]);
+	};
+
+	size_t numWorkers = min<size_t>(m_numThreads, jobs.size());
+	vector<thread> threads;
+	for (size_t k = 1; k < numWorkers; k++)
+		threads.emplace_back(worker);
+	worker();  // the calling thread does its share too
+	for (size_t k = 0; k < threads.size(); k++)
+		threads[k].join();
+	return results;
+}
@@ -0,0 +1,43 @@
+#ifndef PARALLELRUNNER_H_
+#define PARALLELRUNNER_H_
+
+#include "HeadlessHost.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class InputScript;
+
+// Plays many independent worlds headless on a pool of worker threads. Every world has its own host, random stream, GraphObject registry
+// and Actor arena, so the workers share nothing but the (read-only) input scripts and the job list, and throughput grows with the number
+// of cores until the machine runs out of them
+class ParallelRunner
+{
+public:
+	struct Job
+	{
+		std::string			assetPath;
+		uint64_t			seed;
+		int					startLevel;
+		long				maxTicks;
+		const InputScript*	script;		// may be shared by any number of jobs, or nullptr for no input
+	};
+
+	  // A thread count of 0 uses one thread per hardware thread
+	explicit ParallelRunner(unsigned numThreads = 0);
+
+	unsigned numThreads() const
+	{
+		return m_numThreads;
+	}
+
+	  // Run every job to completion and return their results, in the same order as the jobs
+	std::vector<HeadlessHost::Result> run(const std::vector<Job>& jobs) const;
+
+	static HeadlessHost::Result runOne(const Job& job);
+
+private:
+	unsigned m_numThreads;
+};
+
+#endif // PARALLELRUNNER_H_
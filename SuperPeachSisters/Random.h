@@ -0,0 +1,55 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <cstdint>
+#include <utility>
+
+// Small seedable random number stream (SplitMix64). Each GameWorld owns one so that a world's randomness depends only on its seed and on what
+// happens in that world, not on other worlds or on the standard library: the whole state is one 64-bit word, which can be read back with
+// state() and restored with setState() to resume the stream exactly where it left off
+class Random
+{
+	public:
+		explicit Random(uint64_t seed = 0)
+		 : m_state(seed)
+		{
+		}
+
+		void seed(uint64_t seed) { m_state = seed; }
+
+		uint64_t state() const { return m_state; }
+		void setState(uint64_t state) { m_state = state; }
+
+		uint64_t next()
+		{
+			return mix(m_state += 0x9E3779B97F4A7C15ULL);
+		}
+
+		// SplitMix64's output function on its own: scrambles a 64-bit word so that every input bit affects every output bit. Also used to
+		// hash world state
+		static uint64_t mix(uint64_t z)
+		{
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		// Return a uniformly distributed random int from min to max, inclusive
+		int randInt(int min, int max)
+		{
+			if (max < min)
+				std::swap(max, min);
+			uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min) + 1;
+			uint64_t limit = UINT64_MAX - UINT64_MAX % range; // Reject the uneven tail so every value is equally likely
+			uint64_t r;
+			do
+				r = next();
+			while (r >= limit);
+			return static_cast<int>(min + static_cast<int64_t>(r % range));
+		}
+
+	private:
+		uint64_t m_state;
+};
+
+#endif // RANDOM_H_
@@ -12,6 +12,7 @@
 class SoundFXController
 {
   public:
+	typedef irrklang::ISoundSource* Clip;
 
 	void playClip(std::string soundFile)
 	{
@@ -19,17 +20,26 @@ class SoundFXController
 			m_engine->play2D(soundFile.c_str(), false);
 	}
 
+	  // Decode a sound file once, up front, so that playing it later does no file I/O
+	Clip loadClip(std::string soundFile)
+	{
+		if (m_engine == nullptr)
+			return nullptr;
+		return m_engine->addSoundSourceFromFile(soundFile.c_str(), irrklang::ESM_AUTO_DETECT, true);
+	}
+
+	void playClip(Clip clip)
+	{
+		if (m_engine != nullptr && clip != nullptr)
+			m_engine->play2D(clip, false);
+	}
+
 	void abortClip()
 	{
 		if (m_engine != nullptr)
 			m_engine->stopAllSounds();
 	}
 
-	static SoundFXController& getInstance();
-
-  private:
-	irrklang::ISoundEngine* m_engine;
-
 	SoundFXController()
 	{
 		m_engine = irrklang::createIrrKlangDevice();
@@ -44,6 +54,9 @@ class SoundFXController
 			m_engine->drop();
 	}
 
+  private:
+	irrklang::ISoundEngine* m_engine;
+
 	SoundFXController(const SoundFXController&);
 	SoundFXController& operator=(const SoundFXController&);
 };
@@ -58,10 +71,17 @@ class SoundFXController
 class SoundFXController
 {
   public:
+    typedef std::string Clip;  // afplay reads the file itself each time
+
     SoundFXController()
      : pidValid(false)
     {}
 
+    Clip loadClip(std::string soundFile)
+    {
+        return soundFile;
+    }
+
     void playClip(std::string soundFile)
     {
         char cmd[] = "/usr/bin/afplay";
@@ -78,8 +98,6 @@ class SoundFXController
             kill(pid, SIGINT);
         pidValid = false;
     }
-    
-    static SoundFXController& getInstance();
 
   private:
     pid_t pid;
@@ -91,23 +109,14 @@ class SoundFXController
 class SoundFXController
 {
   public:
+    typedef int Clip;
+
     void playClip(std::string) {}
+    Clip loadClip(std::string) { return 0; }
+    void playClip(Clip) {}
     void abortClip() {}
-    static SoundFXController& getInstance();
 };
 
 #endif
 
-  // Meyers singleton pattern
-inline SoundFXController& SoundFXController::getInstance()
-{
-	static SoundFXController instance;
-	return instance;
-}
-
-inline SoundFXController& SoundFX()
-{
-	return SoundFXController::getInstance();
-}
-
 #endif // SOUNDFX_H_
@@ -0,0 +1,127 @@
+#ifndef SPATIALGRID_H_
+#define SPATIALGRID_H_
+
+#include "GameConstants.h"
+#include "Actor.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Uniform grid of SPRITE_WIDTH x SPRITE_HEIGHT cells used to speed up overlap queries. Each Actor is bucketed by the cell containing its
+// lower-left corner, so a sprite-sized box at (x, y) can only overlap Actors bucketed in the (at most) 3x3 block of cells around it. Positions
+// outside of the grid are clamped to the nearest edge cell, which keeps queries correct (just slower) for anything that strays off the board
+class SpatialGrid
+{
+	public:
+		SpatialGrid(int width = GRID_WIDTH, int height = GRID_HEIGHT)
+		 : m_width(width), m_height(height), m_cells(width * height)
+		{
+		}
+
+		// Each Actor in the grid knows its slot (its index within its cell), so removing it needs no search
+		void insert(Actor* actor, double x, double y)
+		{
+			std::vector<Actor*>& cell = m_cells[cellIndex(x, y)];
+			actor->setGridSlot(static_cast<int>(cell.size()));
+			cell.push_back(actor);
+		}
+
+		// Returns false if the Actor was not in the grid to begin with
+		bool remove(Actor* actor, double x, double y)
+		{
+			int slot = actor->gridSlot();
+			if (slot < 0)
+				return false;
+			std::vector<Actor*>& cell = m_cells[cellIndex(x, y)];
+			Actor* last = cell.back(); // No particular order is kept within a cell, so swap with the back for an O(1) removal
+			cell[slot] = last;
+			last->setGridSlot(slot);
+			cell.pop_back();
+			actor->setGridSlot(-1);
+			return true;
+		}
+
+		// Only touches the cells if the Actor actually crossed a cell boundary, which is rare since Actors move at most a few pixels per tick
+		void move(Actor* actor, double oldX, double oldY, double newX, double newY)
+		{
+			if (actor->gridSlot() < 0)
+				return;
+			int from = cellIndex(oldX, oldY);
+			int to = cellIndex(newX, newY);
+			if (from != to)
+			{
+				remove(actor, oldX, oldY);
+				insert(actor, newX, newY);
+			}
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i < m_cells.size(); i++)
+				m_cells[i].clear(); // clear() keeps each cell's capacity, so refilling the grid on the next level is cheap
+		}
+
+		// Append every Actor that could overlap a sprite-sized box at (x, y) to out; callers still need to do the exact overlap check
+		void collect(double x, double y, std::vector<Actor*>& out) const
+		{
+			int minCol, maxCol, minRow, maxRow;
+			neighbourhood(x, y, minCol, maxCol, minRow, maxRow);
+			for (int row = minRow; row <= maxRow; row++)
+				for (int col = minCol; col <= maxCol; col++)
+				{
+					const std::vector<Actor*>& cell = m_cells[row * m_width + col];
+					out.insert(out.end(), cell.begin(), cell.end());
+				}
+		}
+
+		// Return true as soon as pred returns true for any Actor that could overlap a sprite-sized box at (x, y)
+		template <typename Pred>
+		bool any(double x, double y, Pred pred) const
+		{
+			int minCol, maxCol, minRow, maxRow;
+			neighbourhood(x, y, minCol, maxCol, minRow, maxRow);
+			for (int row = minRow; row <= maxRow; row++)
+				for (int col = minCol; col <= maxCol; col++)
+				{
+					const std::vector<Actor*>& cell = m_cells[row * m_width + col];
+					for (size_t i = 0; i < cell.size(); i++)
+						if (pred(cell[i]))
+							return true;
+				}
+			return false;
+		}
+
+	private:
+		int m_width;
+		int m_height;
+		std::vector<std::vector<Actor*>> m_cells; // Indexed by [row * m_width + col]
+
+		static int clamp(int value, int low, int high)
+		{
+			return std::max(low, std::min(value, high));
+		}
+
+		int column(double x) const { return clamp(cellOf(x, SPRITE_WIDTH), 0, m_width - 1); }
+		int row(double y) const { return clamp(cellOf(y, SPRITE_HEIGHT), 0, m_height - 1); }
+		int cellIndex(double x, double y) const { return row(y) * m_width + column(x); }
+
+		// floor(v / size), with a shortcut for the whole, non-negative pixel positions nearly everything is at
+		static int cellOf(double v, int size)
+		{
+			int whole = static_cast<int>(v);
+			if (whole == v && whole >= 0)
+				return whole / size;
+			return static_cast<int>(std::floor(v / size));
+		}
+
+		// Two sprites overlap if their lower-left corners are within SPRITE_WIDTH - 1 (or SPRITE_HEIGHT - 1) of each other along both axes
+		void neighbourhood(double x, double y, int& minCol, int& maxCol, int& minRow, int& maxRow) const
+		{
+			minCol = column(x - (SPRITE_WIDTH - 1));
+			maxCol = column(x + (SPRITE_WIDTH - 1));
+			minRow = row(y - (SPRITE_HEIGHT - 1));
+			maxRow = row(y + (SPRITE_HEIGHT - 1));
+		}
+};
+
+#endif // SPATIALGRID_H_
@@ -11,20 +11,29 @@
 #define GL_BGRA GL_BGRA_EXT
 #endif
 
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
 #include "GameConstants.h"
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <map>
+#include <vector>
 #include <memory>
+#include <cmath>
+#include <algorithm>
 
+// Sprite frames are packed into atlas pages: each frame is scaled to fit one fixed-size cell, leaving a gutter of its own edge pixels around
+// it so that filtering never reaches into the neighbouring cell. Cells are a power of two in size and aligned to their size, so every mipmap
+// texel down to one per cell covers only one frame, and drawing a frame just selects its page and its rectangle of texture coordinates
 class SpriteManager
 {
 public:
 
 	SpriteManager()
-	 : m_mipMapped(true)
+	 : m_mipMapped(true), m_cellsUsed(0), m_batchCount(0)
 	{
 	}
 
@@ -37,12 +46,9 @@ public:
 	{
 		  // Load Texture Data From TGA File
 
-		unsigned int spriteID = getSpriteID(imageID, frameNum);
-		if (INVALID_SPRITE_ID == spriteID)
+		if (imageID < 0 || imageID >= MAX_IMAGES || frameNum < 0 || frameNum >= MAX_FRAMES_PER_SPRITE)
 			return false;
 
-		m_frameCountPerSprite[imageID]++;	// keep track of how many frames per sprite we loaded
-
 		std::string line;
 		std::string contents = "";
 		std::ifstream tgaFile(filename_tga, std::ios::in|std::ios::binary);
@@ -85,75 +91,55 @@ public:
       flipVertical(imageData.get(),header.width_pixels,header.height_pixels,byteCount);
     }
 
-		// Transfer Texture To OpenGL
-
-		glEnable(GL_DEPTH_TEST);
-
-		  // allocate a texture handle
-		GLuint glTextureID;
-		glGenTextures(1, &glTextureID);
+		  // Copy the frame into the next free atlas cell; the pages go to OpenGL on the next draw
 
-		  // bind our new texture
-		glBindTexture(GL_TEXTURE_2D, glTextureID);
-
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-		if (m_mipMapped)
-		{
-			  // when texture area is small, bilinear filter the closest mipmap
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			  // when texture area is large, bilinear filter the first mipmap
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		}
-		else
+		if (m_pages.empty() || m_cellsUsed == CELLS_PER_PAGE)
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			m_pages.push_back(AtlasPage());
+			m_pages.back().pixels.assign(ATLAS_SIZE * ATLAS_SIZE * 4, 0);
+			m_cellsUsed = 0;
 		}
-
-		  // Have the texture wrap both vertically and horizontally.
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_REPEAT));
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_REPEAT));
-
-		if (m_mipMapped)
-		{
-			  // build our texture mipmaps
-			  // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-            makeMipmaps(byteCount, textureWidth, textureHeight, imageData.get());
-        }
-		else
-		{
-			  // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-			if (3 == byteCount)
-				glTexImage2D(GL_TEXTURE_2D, 0, 3, textureWidth, textureHeight, 0, GL_BGR, GL_UNSIGNED_BYTE, imageData.get());
-			else if (4 == byteCount)
-				glTexImage2D(GL_TEXTURE_2D, 0, 4, textureWidth, textureHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, imageData.get());
-		}
-
-		m_imageMap[spriteID] = glTextureID;
+		AtlasPage& page = m_pages.back();
+		int cellX = (m_cellsUsed % CELLS_PER_ROW) * ATLAS_CELL;
+		int cellY = (m_cellsUsed / CELLS_PER_ROW) * ATLAS_CELL;
+		m_cellsUsed++;
+		copyToCell(page.pixels, cellX, cellY, reinterpret_cast<const unsigned char*>(imageData.get()), textureWidth, textureHeight, byteCount);
+		page.uploaded = false;
+
+		if (static_cast<size_t>(imageID) >= m_images.size())
+			m_images.resize(imageID + 1);
+		ImageFrames& image = m_images[imageID];
+		image.numFrames++;	// keep track of how many frames per sprite we loaded
+		if (static_cast<size_t>(frameNum) >= image.frames.size())
+			image.frames.resize(frameNum + 1);
+
+		AtlasFrame& frame = image.frames[frameNum];
+		frame.loaded = true;
+		frame.page = m_pages.size() - 1;
+		frame.u0 = static_cast<GLfloat>(cellX + ATLAS_GUTTER) / ATLAS_SIZE;
+		frame.v0 = static_cast<GLfloat>(cellY + ATLAS_GUTTER) / ATLAS_SIZE;
+		frame.u1 = static_cast<GLfloat>(cellX + ATLAS_CELL - ATLAS_GUTTER) / ATLAS_SIZE;
+		frame.v1 = static_cast<GLfloat>(cellY + ATLAS_CELL - ATLAS_GUTTER) / ATLAS_SIZE;
 
 		return true;
 	}
 
 	unsigned int getNumFrames(int imageID) const
 	{
-		auto it = m_frameCountPerSprite.find(imageID);
-		if (it == m_frameCountPerSprite.end())
+		if (imageID < 0 || static_cast<size_t>(imageID) >= m_images.size())
 			return 0;
 
-		return it->second;
+		return m_images[imageID].numFrames;
 	}
 
 
 	bool plotSprite(int imageID, int frame, double gx, double gy, double gz, int angleDegrees, double size)
 	{
-		unsigned int spriteID = getSpriteID(imageID,frame);
-		if (INVALID_SPRITE_ID == spriteID)
-			return false;
-
-		auto it = m_imageMap.find(spriteID);
-		if (it == m_imageMap.end())
+		const AtlasFrame* found = findFrame(imageID, frame);
+		if (found == nullptr)
 			return false;
+		const AtlasFrame& cell = *found;
+		uploadPages();
 
 		glPushMatrix();
 
@@ -172,17 +158,17 @@ public:
 		glDisable(GL_DEPTH_TEST);
 		glEnable (GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glBindTexture(GL_TEXTURE_2D, it->second);
+		glBindTexture(GL_TEXTURE_2D, m_pages[cell.page].texture);
 
 		glColor3f(1.0, 1.0, 1.0);
 
 		double cx1,cx2,cx3,cx4;
 		double cy1,cy2,cy3,cy4;
 
-		cx1 = cy1 = 0;
-		cx2 = 1; cy2 = 0;
-		cx3 = 1; cy3 = 1;
-		cx4 = 0; cy4 = 1;
+		cx1 = cell.u0; cy1 = cell.v0;
+		cx2 = cell.u1; cy2 = cell.v0;
+		cx3 = cell.u1; cy3 = cell.v1;
+		cx4 = cell.u0; cy4 = cell.v1;
 
 		double rx1, ry1, rx2, ry2, rx3, ry3, rx4, ry4;
 
@@ -248,10 +234,104 @@ public:
 		return true;
 	}
 
+	  // Batched drawing: between beginBatch() and drawBatch(), addSprite() only records each sprite's quad, and drawBatch() then sets up the
+	  // GL state once and draws all the recorded quads with one glDrawArrays per atlas page, in the order each page was first used. Like
+	  // plotSprite(), sprites are drawn without depth testing, so call drawBatch() once per depth, farthest first
+
+	void beginBatch()
+	{
+		uploadPages();  // Up front, so that a batch can be compiled into a display list without the texture uploads going in with it
+		for (size_t k = 0; k < m_batchCount; k++)
+		{
+			m_batchIndex[m_batches[k].page] = NO_BATCH;
+			m_batches[k].vertices.clear();
+			m_batches[k].texCoords.clear();
+		}
+		m_batchCount = 0;
+	}
+
+	bool addSprite(int imageID, int frame, double gx, double gy, double gz, int angleDegrees, double size)
+	{
+		const AtlasFrame* found = findFrame(imageID, frame);
+		if (found == nullptr)
+			return false;
+		const AtlasFrame& cell = *found;
+
+		if (m_batchIndex.size() < m_pages.size())
+			m_batchIndex.resize(m_pages.size(), static_cast<size_t>(NO_BATCH));
+		if (m_batchIndex[cell.page] == NO_BATCH)
+		{
+			if (m_batchCount == m_batches.size())
+				m_batches.push_back(Batch());
+			m_batches[m_batchCount].page = cell.page;
+			m_batchIndex[cell.page] = m_batchCount++;
+		}
+		Batch& batch = m_batches[m_batchIndex[cell.page]];
+
+		const double halfWidth = SPRITE_WIDTH_GL * size / 2;
+		const double halfHeight = SPRITE_HEIGHT_GL * size / 2;
+
+		  // Same corners as plotSprite(), but with one cos/sin per sprite and the translation folded into the vertices
+		bool mirror = (angleDegrees == 180);  // Ensure actors rotated to face left aren't upside-down.
+		double theta = (mirror ? 0 : angleDegrees) * 1.0 / 360 * 2 * 3.14159;
+		double c = cos(theta);
+		double s = sin(theta);
+		static const double cornerX[4] = { -1, 1, 1, -1 };
+		static const double cornerY[4] = { -1, -1, 1, 1 };
+		const GLfloat texX[4] = { cell.u0, cell.u1, cell.u1, cell.u0 };
+		const GLfloat texY[4] = { cell.v0, cell.v0, cell.v1, cell.v1 };
+		static const int mirrored[4] = { 1, 0, 3, 2 };
+		for (int k = 0; k < 4; k++)
+		{
+			int corner = (mirror ? mirrored[k] : k);
+			double x = cornerX[corner] * halfWidth;
+			double y = cornerY[corner] * halfHeight;
+			batch.vertices.push_back(static_cast<GLfloat>(gx + x * c - y * s));
+			batch.vertices.push_back(static_cast<GLfloat>(gy + y * c + x * s));
+			batch.vertices.push_back(static_cast<GLfloat>(gz));
+			batch.texCoords.push_back(texX[k]);
+			batch.texCoords.push_back(texY[k]);
+		}
+		return true;
+	}
+
+	void drawBatch()
+	{
+		if (m_batchCount == 0)
+			return;
+
+		glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+		glEnable(GL_TEXTURE_2D);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glColor3f(1.0, 1.0, 1.0);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+		for (size_t k = 0; k < m_batchCount; k++)
+		{
+			const Batch& batch = m_batches[k];
+			glBindTexture(GL_TEXTURE_2D, m_pages[batch.page].texture);
+			glVertexPointer(3, GL_FLOAT, 0, batch.vertices.data());
+			glTexCoordPointer(2, GL_FLOAT, 0, batch.texCoords.data());
+			glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(batch.vertices.size() / 3));
+		}
+
+		glDisable(GL_TEXTURE_2D);
+		glEnable(GL_DEPTH_TEST);
+		glPopClientAttrib();
+		glPopAttrib();
+	}
+
 	~SpriteManager()
 	{
-		for (auto it = m_imageMap.begin(); it != m_imageMap.end(); it++)
-			glDeleteTextures(1, &it->second);
+		for (size_t k = 0; k < m_pages.size(); k++)
+		{
+			if (m_pages[k].texture != 0)
+				glDeleteTextures(1, &m_pages[k].texture);
+		}
 	}
 
 private:
@@ -292,22 +372,167 @@ private:
     }
   }
 
+	static const int ATLAS_SIZE = 1024;		// Each page is ATLAS_SIZE x ATLAS_SIZE texels
+	static const int ATLAS_CELL = 128;		// One frame per ATLAS_CELL x ATLAS_CELL cell, including its gutter
+	static const int ATLAS_GUTTER = 8;
+	static const int CELLS_PER_ROW = ATLAS_SIZE / ATLAS_CELL;
+	static const int CELLS_PER_PAGE = CELLS_PER_ROW * CELLS_PER_ROW;
+	static const int ATLAS_MAX_LEVEL = 7;	// log2(ATLAS_CELL): one texel per cell
+
+	struct AtlasPage
+	{
+		AtlasPage()
+		 : texture(0), uploaded(false)
+		{
+		}
+
+		std::vector<unsigned char> pixels;	// BGRA, kept so the page can be uploaded again if more frames are added to it
+		GLuint texture;
+		bool   uploaded;
+	};
+
+	struct AtlasFrame
+	{
+		AtlasFrame()
+		 : loaded(false), page(0), u0(0), v0(0), u1(0), v1(0)
+		{
+		}
+
+		bool	loaded;
+		size_t	page;
+		GLfloat u0, v0, u1, v1;	// The frame's rectangle on its page, inside the gutter
+	};
+
+	struct ImageFrames
+	{
+		ImageFrames()
+		 : numFrames(0)
+		{
+		}
+
+		unsigned int			numFrames;
+		std::vector<AtlasFrame> frames;		// Indexed by frame number
+	};
+
+	struct Batch
+	{
+		size_t				 page;
+		std::vector<GLfloat> vertices;	// x, y, z for each corner of each quad
+		std::vector<GLfloat> texCoords;	// s, t for each corner of each quad
+	};
+
 	bool							m_mipMapped;
-	std::map<unsigned int, GLuint>	m_imageMap;
-	std::map<unsigned int, unsigned int>		m_frameCountPerSprite;
+	std::vector<ImageFrames>		m_images;		// Indexed by image ID, so finding a frame is two array lookups
+	std::vector<AtlasPage>			m_pages;
+	int								m_cellsUsed;	// On the last page
+	std::vector<Batch>				m_batches;		// Only the first m_batchCount are in use; the rest keep their capacity for later frames
+	size_t							m_batchCount;
+	std::vector<size_t>				m_batchIndex;	// Indexed by page: index into m_batches, or NO_BATCH
 
-	static const int INVALID_SPRITE_ID = -1;
-	static const int MAX_IMAGES = 1000;
-	static const int MAX_FRAMES_PER_SPRITE = 100;
+	static const size_t NO_BATCH = static_cast<size_t>(-1);
 
-	int getSpriteID(unsigned int imageID, unsigned int frame) const
+	const AtlasFrame* findFrame(int imageID, int frame) const
 	{
-		if (imageID >= MAX_IMAGES || frame >= MAX_FRAMES_PER_SPRITE)
-			return INVALID_SPRITE_ID;
+		if (imageID < 0 || static_cast<size_t>(imageID) >= m_images.size())
+			return nullptr;
+		const std::vector<AtlasFrame>& frames = m_images[imageID].frames;
+		if (frame < 0 || static_cast<size_t>(frame) >= frames.size() || !frames[frame].loaded)
+			return nullptr;
+		return &frames[frame];
+	}
+
+	  // Scale a BGR or BGRA image to fill the inside of the cell at (cellX, cellY), averaging the source pixels that land on each cell
+	  // pixel, then extend its edge pixels out across the gutter
+	static void copyToCell(std::vector<unsigned char>& page, int cellX, int cellY, const unsigned char* image,
+						   unsigned int width, unsigned int height, unsigned char byteCount)
+	{
+		const int inner = ATLAS_CELL - 2 * ATLAS_GUTTER;
+		for (int y = 0; y < inner; y++)
+		{
+			unsigned int sy0 = y * height / inner;
+			unsigned int sy1 = std::max(sy0 + 1, (y + 1) * height / inner);
+			for (int x = 0; x < inner; x++)
+			{
+				unsigned int sx0 = x * width / inner;
+				unsigned int sx1 = std::max(sx0 + 1, (x + 1) * width / inner);
+				unsigned int sum[4] = { 0, 0, 0, 0 };
+				for (unsigned int sy = sy0; sy < sy1; sy++)
+				{
+					for (unsigned int sx = sx0; sx < sx1; sx++)
+					{
+						const unsigned char* p = image + (sy * width + sx) * byteCount;
+						sum[0] += p[0];
+						sum[1] += p[1];
+						sum[2] += p[2];
+						sum[3] += (byteCount == 4 ? p[3] : 255);
+					}
+				}
+				unsigned int count = (sx1 - sx0) * (sy1 - sy0);
+				unsigned char* q = &page[((cellY + ATLAS_GUTTER + y) * ATLAS_SIZE + cellX + ATLAS_GUTTER + x) * 4];
+				for (int c = 0; c < 4; c++)
+					q[c] = static_cast<unsigned char>(sum[c] / count);
+			}
+		}
 
-		return imageID * MAX_FRAMES_PER_SPRITE + frame;
+		const int first = ATLAS_GUTTER;
+		const int last = ATLAS_CELL - ATLAS_GUTTER - 1;
+		for (int y = 0; y < ATLAS_CELL; y++)
+		{
+			int sy = std::min(std::max(y, first), last);
+			for (int x = 0; x < ATLAS_CELL; x++)
+			{
+				int sx = std::min(std::max(x, first), last);
+				if (sx != x || sy != y)
+					std::memcpy(&page[((cellY + y) * ATLAS_SIZE + cellX + x) * 4], &page[((cellY + sy) * ATLAS_SIZE + cellX + sx) * 4], 4);
+			}
+		}
 	}
 
+	  // Hand any pages that have changed since the last draw to OpenGL
+	void uploadPages()
+	{
+		for (size_t k = 0; k < m_pages.size(); k++)
+		{
+			AtlasPage& page = m_pages[k];
+			if (page.uploaded)
+				continue;
+
+			if (page.texture == 0)
+				glGenTextures(1, &page.texture);
+			glBindTexture(GL_TEXTURE_2D, page.texture);
+
+			glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+			if (m_mipMapped)
+			{
+				  // when texture area is small, bilinear filter the closest mipmap
+				glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				  // when texture area is large, bilinear filter the first mipmap
+				glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				  // any smaller and a texel would span several frames
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ATLAS_MAX_LEVEL);
+			}
+			else
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			}
+
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_REPEAT));
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_REPEAT));
+
+			char* pixels = reinterpret_cast<char*>(page.pixels.data());
+			if (m_mipMapped)
+				makeMipmaps(4, ATLAS_SIZE, ATLAS_SIZE, pixels);
+			else
+				glTexImage2D(GL_TEXTURE_2D, 0, 4, ATLAS_SIZE, ATLAS_SIZE, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+			page.uploaded = true;
+		}
+	}
+
+	static const int MAX_IMAGES = 1000;
+	static const int MAX_FRAMES_PER_SPRITE = 100;
+
     static void makeMipmaps(unsigned char byteCount, unsigned int textureWidth, unsigned int textureHeight, char* imageData)
     {
         int format = (byteCount == 3 ? GL_BGR : GL_BGRA);
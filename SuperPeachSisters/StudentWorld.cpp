@@ -5,8 +5,19 @@
 #include <iomanip>
 #include <string>
 #include <algorithm>
+#include <cstring>
+#include <atomic>
 using namespace std;
 
+// Compare Actor pointers by the Actors they point to, for use with STL algorithms 
+static bool actorLess(const Actor* a, const Actor* b)
+{
+    return *a < *b;
+}
+
+// Ids for cloneFrom() to tell worlds apart by; worlds may be created on more than one thread 
+static atomic<uint64_t> nextWorldId(1);
+
 GameWorld* createStudentWorld(string assetPath)
 {
     return new StudentWorld(assetPath);
@@ -16,9 +27,19 @@ StudentWorld::StudentWorld(string assetPath)
     : GameWorld(assetPath)
 {
     // Initialize member variables 
+    m_peach = nullptr;
     m_actors = vector<Actor*>();
     m_numSpecialActors = 0;
     m_finalLevel = false;
+    m_bulkLoading = false;
+    m_template.level = nullptr;
+    m_template.levelNumber = 0;
+    m_actorHash = 0;
+    m_statusShown = false;
+    m_worldId = nextWorldId++;
+    m_version = 0;
+    m_cloneSourceId = 0;
+    m_cloneVersion = 0;
 }
 
 StudentWorld::~StudentWorld()
@@ -28,74 +49,53 @@ StudentWorld::~StudentWorld()
 
 int StudentWorld::init()
 {
-    int level = getLevel();
-    ostringstream oss;
-    oss.fill('0');
-    oss << "level" << setw(2) << level << ".txt";
-
-    Level lev(assetPath());
-    string level_file = oss.str();
-    Level::LoadResult result = lev.loadLevel(level_file);
-    if (result == Level::load_success)
+    m_statusShown = false; // The host may be new, i.e. for a new game, so give it the status line on the first tick 
+    structureChanged();
+    const CompiledLevel* loaded = loadLevel(getLevel());
+    if (loaded != nullptr)
     {
-        Level::GridEntry ge;
-        int dir;
-        // Populate m_actors with appropriate actors from level file 
-        for (int w = 0; w < GRID_WIDTH; w++)
+        const CompiledLevel& lev = *loaded;
+        // The terrain bitmap comes ready-made with the level, or failing that (if it was compiled for a different board size) is rebuilt 
+        // from the level's terrain spans 
+        if (!m_terrain.assign(lev.terrainWords(), lev.numTerrainWords()))
         {
-            for (int c = 0; c < GRID_HEIGHT; c++)
-            {
-                ge = lev.getContentsOf(w, c);
-                switch (ge)
-                {
-                case Level::peach:
-                    m_peach = new Peach(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT);
-                    break;
-                case Level::mushroom_goodie_block:
-                    addActor(new Block(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 1));
-                    break;
-                case Level::flower_goodie_block:
-                    addActor(new Block(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 2));
-                    break;
-                case Level::star_goodie_block:
-                    addActor(new Block(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 3));
-                    break;
-                case Level::block:
-                    addActor(new Block(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 0));
-                    break;
-                case Level::pipe:
-                    addActor(new Pipe(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT));
-                    break;
-                case Level::flag:
-                    addActor(new Flag(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT));
-                    break;
-                case Level::mario:
-                    addActor(new Mario(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT));
-                    break;
-                case Level::goomba:
-                    dir = rand() % 2;
-                    if (dir == 0)
-                        addActor(new Goomba(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 0));
-                    else
-                        addActor(new Goomba(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 180));
-                    break;
-                case Level::koopa:
-                    dir = rand() % 2;
-                    if (dir == 0)
-                        addActor(new Koopa(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 0));
-                    else
-                        addActor(new Koopa(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 180));
-                    break;
-                case Level::piranha:
-                    dir = rand() % 2;
-                    if (dir == 0)
-                        addActor(new Piranha(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 0));
-                    else
-                        addActor(new Piranha(this, w * SPRITE_WIDTH, c * SPRITE_HEIGHT, 180));
-                    break;
-                }
-            }
+            for (size_t i = 0; i < lev.numSpans(); i++)
+                m_terrain.addSpan(lev.spans()[i].x0, lev.spans()[i].x1, lev.spans()[i].y);
         }
+
+        // Populate m_actors with appropriate actors from the level's spawn list, which is in the same column by column order the grid 
+        // has always been read in, so random directions are drawn in the same order too; they are appended as they come and sorted once 
+        // at the end rather than each being inserted into place. Which spawn became which Actor is remembered for restartLevel() 
+        m_template.level = nullptr;
+        m_template.order.clear();
+        m_template.respawns.clear();
+        m_template.goodieBlocks.clear();
+        m_spawned.assign(lev.numSpawns(), nullptr);
+        m_bulkLoading = true;
+        for (size_t i = 0; i < lev.numSpawns(); i++)
+        {
+            Actor* actor = spawnActor(lev.spawns()[i]);
+            m_spawned[i] = actor;
+            if (actor == nullptr)
+                continue;
+            if (!actor->terrain())
+                m_template.respawns.push_back(i);
+            if (actor != m_peach)
+                m_template.order.push_back(i);
+        }
+        m_bulkLoading = false;
+        // Sorting the spawn indices, rather than m_actors itself, gives the order to put the Actors back in on a restart; stable so that 
+        // Actors in the same row stay in the order they were added 
+        stable_sort(m_template.order.begin(), m_template.order.end(), [this](unsigned a, unsigned b) { return *m_spawned[a] < *m_spawned[b]; });
+        m_records.resize(m_template.order.size());
+        for (size_t i = 0; i < m_template.order.size(); i++)
+        {
+            m_actors[i] = m_spawned[m_template.order[i]];
+            m_actors[i]->setActorIndex(i);
+            storeRecord(m_actors[i], m_records[i]);
+        }
+        m_template.level = loaded;
+        m_template.levelNumber = getLevel();
     }
     else
     {
@@ -136,77 +136,259 @@ int StudentWorld::move()
     }
     m_peach->doSomething(); // Allow Peach to do something 
     
-    // Erase all dead Actors from vector 
-    vector<Actor*>::iterator it;
-    it = m_actors.begin();
-    while (it != m_actors.end())
-    {
-        if (!(*it)->alive())
-        {
-            if ((*it)->priority()) // If the Actor was a priority actor, make sure to decrement m_numSpecialActors counter 
-                m_numSpecialActors--; 
-            delete* it;
-            it = m_actors.erase(it);
-        }
-        else
-            it++;
-    }
+    removeDeadActors();
 
-    // Display appropriate text 
-    ostringstream oss;
-    oss << "Lives: " << getLives() << "  Level: " << getLevel() << "  Points: " << getScore();
+    updateStatusText();
+
+    return GWSTATUS_CONTINUE_GAME;
+}
+
+// Display appropriate text. It only changes when Peach scores, loses a life or gains or loses a power, so the line is only built (in a 
+// member string, reusing its storage) and handed over when one of those has changed; most ticks don't touch a string at all 
+void StudentWorld::updateStatusText()
+{
+    int powers = (m_peach->getStarPower() ? 1 : 0) | (m_peach->getShootPower() ? 2 : 0) | (m_peach->getJumpPower() ? 4 : 0);
+    if (m_statusShown && m_statusLives == getLives() && m_statusLevel == getLevel() && m_statusScore == getScore() && m_statusPowers == powers)
+        return;
+    m_statusShown = true;
+    m_statusLives = getLives();
+    m_statusLevel = getLevel();
+    m_statusScore = getScore();
+    m_statusPowers = powers;
+
+    m_statusText.clear();
+    m_statusText += "Lives: ";
+    m_statusText += to_string(getLives());
+    m_statusText += "  Level: ";
+    m_statusText += to_string(getLevel());
+    m_statusText += "  Points: ";
+    m_statusText += to_string(getScore());
     if (m_peach->getStarPower())
-        oss << " StarPower!";
+        m_statusText += " StarPower!";
     if (m_peach->getShootPower())
-        oss << " ShootPower!";
+        m_statusText += " ShootPower!";
     if (m_peach->getJumpPower())
-        oss << " JumpPower!";
-    setGameStatText(oss.str());
+        m_statusText += " JumpPower!";
+    setGameStatText(m_statusText);
+}
 
+// Create the Actor for one entry of a level's spawn list, Peach included; Goombas, Koopas and Piranhas face a random direction. Blocks 
+// with goodies are noted so that restartLevel() can give the goodies back 
+Actor* StudentWorld::spawnActor(const CompiledLevel::Spawn& spawn)
+{
+    int x = spawn.x;
+    int y = spawn.y;
+    int dir;
+    Block* block;
+    switch (spawn.entry)
+    {
+    case Level::peach:
+        m_peach = m_arena.create<Peach>(this, x, y);
+        m_peach->updateStateHash(); // Peach is not in m_actors, so insertActor() never adds her to the world's hash 
+        return m_peach;
+    case Level::mushroom_goodie_block:
+        block = addActor<Block>(x, y, 1);
+        m_template.goodieBlocks.push_back(make_pair(block, 1));
+        return block;
+    case Level::flower_goodie_block:
+        block = addActor<Block>(x, y, 2);
+        m_template.goodieBlocks.push_back(make_pair(block, 2));
+        return block;
+    case Level::star_goodie_block:
+        block = addActor<Block>(x, y, 3);
+        m_template.goodieBlocks.push_back(make_pair(block, 3));
+        return block;
+    case Level::block:
+        return addActor<Block>(x, y, 0);
+    case Level::pipe:
+        return addActor<Pipe>(x, y);
+    case Level::flag:
+        return addActor<Flag>(x, y);
+    case Level::mario:
+        return addActor<Mario>(x, y);
+    case Level::goomba:
+        dir = random().randInt(0, 1);
+        if (dir == 0)
+            return addActor<Goomba>(x, y, 0);
+        else
+            return addActor<Goomba>(x, y, 180);
+    case Level::koopa:
+        dir = random().randInt(0, 1);
+        if (dir == 0)
+            return addActor<Koopa>(x, y, 0);
+        else
+            return addActor<Koopa>(x, y, 180);
+    case Level::piranha:
+        dir = random().randInt(0, 1);
+        if (dir == 0)
+            return addActor<Piranha>(x, y, 0);
+        else
+            return addActor<Piranha>(x, y, 180);
+    default:
+        return nullptr;
+    }
+}
+
+// Put the level back the way init() left it. Terrain never moves or dies, and the only thing about it that changes is that Blocks give 
+// up their goodies, so it stays where it is (objects, spatial grid and bitmap alike) and just gets its goodies back; everything else is 
+// destroyed and created again from the spawn list, drawing random directions in the same order init() did, and then put back in init()'s 
+// sorted order. None of this allocates, since the arena and every vector involved reuse their storage 
+int StudentWorld::restartLevel()
+{
+    if (m_template.level == nullptr || m_template.levelNumber != getLevel())
+        return GameWorld::restartLevel();
+
+    structureChanged();
+    for (size_t i = 0; i < m_actors.size(); i++)
+    {
+        Actor* actor = m_actors[i];
+        if (actor->terrain())
+            continue;
+        m_grid.remove(actor, actor->getX(), actor->getY());
+        m_actorHash -= actor->stateHash();
+        m_arena.destroy(actor);
+    }
+    m_actors.clear();
+    m_records.clear();
+    m_actorHash -= m_peach->stateHash();
+    m_arena.destroy(m_peach);
+    m_peach = nullptr;
+    m_numSpecialActors = 0;
+
+    for (size_t i = 0; i < m_template.goodieBlocks.size(); i++)
+        m_template.goodieBlocks[i].first->setGoodie(m_template.goodieBlocks[i].second);
+
+    const CompiledLevel::Spawn* spawns = m_template.level->spawns();
+    m_bulkLoading = true;
+    for (size_t i = 0; i < m_template.respawns.size(); i++)
+    {
+        unsigned index = m_template.respawns[i];
+        m_spawned[index] = spawnActor(spawns[index]);
+    }
+    m_bulkLoading = false;
+
+    m_actors.resize(m_template.order.size());
+    m_records.resize(m_template.order.size());
+    for (size_t i = 0; i < m_template.order.size(); i++)
+    {
+        m_actors[i] = m_spawned[m_template.order[i]];
+        m_actors[i]->setActorIndex(i);
+        storeRecord(m_actors[i], m_records[i]);
+    }
     return GWSTATUS_CONTINUE_GAME;
 }
 
+// Get the level with the given number, loading it only the first time; after that, starting the level again (i.e. after Peach loses a 
+// life) needs no file I/O or parsing at all. Returns nullptr if the level can't be loaded 
+const CompiledLevel* StudentWorld::loadLevel(int level)
+{
+    map<int, unique_ptr<CompiledLevel>>::iterator it = m_levels.find(level);
+    if (it != m_levels.end())
+        return it->second.get();
+
+    ostringstream oss;
+    oss.fill('0');
+    oss << "level" << setw(2) << level << ".txt";
+    string level_file = m_levelFile.empty() ? oss.str() : m_levelFile;
+    if (!assetPath().empty())
+        level_file = assetPath() + "/" + level_file;
+
+    unique_ptr<CompiledLevel> lev(new CompiledLevel);
+    if (lev->load(level_file) != Level::load_success)
+        return nullptr;
+    return (m_levels[level] = std::move(lev)).get();
+}
+
 void StudentWorld::cleanUp()
 {
-    // Delete all actors and Peach 
-    vector<Actor*>::iterator it;
-    it = m_actors.begin();
-    while (it != m_actors.end())
+    // Delete all actors and Peach, then empty the vector in one go rather than erasing from the front one Actor at a time 
+    structureChanged();
+    for (size_t i = 0; i < m_actors.size(); i++)
+        m_arena.destroy(m_actors[i]);
+    m_actors.clear();
+    m_records.clear();
+    if (m_peach != nullptr)
+        m_arena.destroy(m_peach);
+    m_peach = nullptr;
+    m_grid.clear();
+    m_terrain.clear();
+    m_numSpecialActors = 0;
+    m_actorHash = 0;
+    m_template.level = nullptr; // The terrain it kept is gone 
+}
+
+// Erase all dead Actors from the vector in a single pass. Living Actors are shifted down over the dead ones in their original order, so 
+// m_actors stays sorted and the priority actors stay at the end, while the dead ones are destroyed as they are passed over 
+void StudentWorld::removeDeadActors()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < m_actors.size(); i++)
     {
-        delete* it;
-        it = m_actors.erase(it);
+        Actor* actor = m_actors[i];
+        if (actor->alive())
+        {
+            actor->setActorIndex(kept);
+            m_records[kept] = m_records[i];
+            m_actors[kept++] = actor;
+            continue;
+        }
+        if (actor->priority()) // If the Actor was a priority actor, make sure to decrement m_numSpecialActors counter 
+            m_numSpecialActors--;
+        m_grid.remove(actor, actor->getX(), actor->getY());
+        m_actorHash -= actor->stateHash();
+        m_arena.destroy(actor);
     }
-    delete m_peach;
-    m_numSpecialActors = 0;
+    if (kept < m_actors.size())
+        structureChanged();
+    m_actors.resize(kept);
+    m_records.resize(kept);
 }
 
-void StudentWorld::addActor(Actor* actor)
+void StudentWorld::insertActor(Actor* actor)
 {
-    if (actor->priority()) // If the actor being added is a priority actor, make sure to increment the priority actor counter 
-        m_numSpecialActors++;
+    structureChanged();
+    m_grid.insert(actor, actor->getX(), actor->getY());
+    actor->updateStateHash();
+    if (actor->terrain() && !m_bulkLoading) // Terrain never moves, so it only has to be recorded in the blocking bitmap once; init() loads the level's own bitmap 
+        m_terrain.addTile(static_cast<int>(actor->getX()), static_cast<int>(actor->getY()));
 
-    if (m_actors.size() == 0) // Size zero, just push_back 
+    if (actor->priority()) // If the actor being added is a priority actor, make sure to increment the priority actor counter 
     {
+        // Priority actors can move vertically, so there is no meaningful order among them; they just need to come after every other Actor, 
+        // which appending guarantees. This also means an Actor spawned during move() never shifts the Actor currently being processed 
+        m_numSpecialActors++;
+        actor->setActorIndex(m_actors.size());
         m_actors.push_back(actor);
+        m_records.push_back(ActorRecord());
+        storeRecord(actor, m_records.back());
         return;
     }
 
-    // Insert such that m_actors is in ascending order as defined by < 
-    vector<Actor*>::iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
+    if (m_bulkLoading) // init() sorts everything once it has added the whole level, and numbers and records the Actors then 
     {
-        if (*actor < *(*it))
-        {
-            m_actors.insert(it, actor);
-            return;
-        }
+        m_actors.push_back(actor);
+        return;
     }
-    m_actors.insert(it, actor); // In case of no insertion occurring in loop - probably redundant though
+
+    // Insert such that m_actors is in ascending order as defined by <, after any Actors that compare equal to keep insertion order. Every 
+    // Actor after it moves up one, so they are numbered again, which costs no more than the insert itself 
+    vector<Actor*>::iterator end = m_actors.end() - m_numSpecialActors;
+    size_t at = m_actors.insert(upper_bound(m_actors.begin(), end, actor, actorLess), actor) - m_actors.begin();
+    for (size_t i = at; i < m_actors.size(); i++)
+        m_actors[i]->setActorIndex(i);
+    m_records.insert(m_records.begin() + at, ActorRecord());
+    storeRecord(actor, m_records[at]);
 }
 
 // If there is a blockable object overlapping at a given (x, y) coordinate 
 bool StudentWorld::isBlockingAt(double x, double y) const
 {
+    // Terrain is the only thing that blocks and it never moves, so whole-pixel positions (which is every position in practice, since all 
+    // movement is in whole pixels) can be answered straight from the precomputed bitmap 
+    int px = static_cast<int>(x);
+    int py = static_cast<int>(y);
+    if (px == x && py == y)
+        return m_terrain.blockingAt(px, py);
     return blockOrDamageAt(x, y, true);
 }
 
@@ -238,61 +420,377 @@ void StudentWorld::getPlayerLocation(double& x, double& y) const
 // Bonk an object at a given location 
 bool StudentWorld::bonkAt(double x, double y, const Actor& actor) 
 {
-    bool bonked = false;
-    bool lower;
-    int i;
-    // Iterate through prioritized Actors (fireballs, goodies, etc.)
-    // There are m_numSpecialActors prioritized actors, and they are guaranteed to all be at the end of the Vector, so start looping from 
-    // m_actors.size() - m_numSpecialActors and go to the end 
-    for (i = m_actors.size() - m_numSpecialActors; i < m_actors.size(); i++)
+    // Gather the nearby Actors before bonking any of them, since a bonk can add new Actors (i.e. a Koopa's Shell or a Block's Goodie) into 
+    // the very grid cells that are being visited 
+    m_nearby.clear();
+    m_grid.collect(x, y, m_nearby);
+
+    m_hits.clear();
+    for (size_t i = 0; i < m_nearby.size(); i++)
     {
-        if (overlap(x, x + SPRITE_WIDTH - 1, m_actors[i]->getX(), m_actors[i]->getX() + SPRITE_WIDTH - 1, lower) && overlap(y, y + SPRITE_HEIGHT - 1, m_actors[i]->getY(), m_actors[i]->getY() + SPRITE_HEIGHT - 1, lower))
-        {
-            if (m_actors[i] != &actor) // Check to ensure that the actor doing the bonking is not bonking itself (no self bonking)
-            {
-                m_actors[i]->bonk(actor);
-                bonked = true;
-            }
-        }
+        if (m_nearby[i] != &actor && overlapsActor(x, y, *m_nearby[i])) // Check to ensure that the actor doing the bonking is not bonking itself (no self bonking)
+            m_hits.push_back(make_pair(size_t(0), m_nearby[i]));
     }
 
-    // Use binary search based on vertical position to search for remaining actors at the given vertical position  
-    i = actorBinarySearch(y, m_actors, 0, m_actors.size() - m_numSpecialActors); // The end index if m_actors.size() - m_numSpecialActors since binary search cannot be performed with specialActors (hence why they were iterated through manually)
-    if (i == -1) // No vertical matches 
+    // The grid returns Actors in no meaningful order, so when more than one is hit they are sorted into a fixed one, so that side effects 
+    // such as points and spawned goodies always happen in the same order: prioritized Actors first, in the order they were added, then 
+    // the rest by y position. This is the order the old linear scan mostly bonked in, except that Actors at the same height are bonked in 
+    // m_actors order rather than outward from wherever its binary search happened to land 
+    if (m_hits.size() > 1)
+    {
+        for (size_t i = 0; i < m_hits.size(); i++)
+            m_hits[i].first = bonkRank(m_hits[i].second);
+        sort(m_hits.begin(), m_hits.end());
+    }
+    for (size_t i = 0; i < m_hits.size(); i++)
+        m_hits[i].second->bonk(actor);
+    return !m_hits.empty();
+}
+
+// Where an Actor comes in bonkAt()'s order: prioritized Actors by their place at the end of m_actors, then the others by their place in 
+// the sorted part. Both come straight from the index the Actor keeps 
+size_t StudentWorld::bonkRank(const Actor* actor) const
+{
+    size_t index = actor->actorIndex();
+    size_t firstSpecial = m_actors.size() - m_numSpecialActors;
+    return index >= firstSpecial ? index - firstSpecial : m_numSpecialActors + index;
+}
+
+void StudentWorld::countActorsByImage(vector<int>& counts) const
+{
+    counts.assign(NUM_IMAGE_IDS, 0);
+    for (size_t i = 0; i < m_actors.size(); i++)
+        counts[m_actors[i]->getID()]++;
+    if (m_peach != nullptr)
+        counts[m_peach->getID()]++;
+}
+
+// A save state is a SaveHeader followed by one ActorRecord per Actor in m_actors, in m_actors order. Every field has a fixed size and is 
+// in the byte order of the machine that saved it, which byteOrder lets a loader check. ActorRecords have no padding and the header is 
+// zeroed before it is filled in, so the same world always saves to the same bytes 
+struct StudentWorld::SaveHeader
+{
+    char                magic[4];
+    uint32_t            version;
+    uint32_t            byteOrder;
+    uint16_t            gridWidth; // The board the positions in the ActorRecords are on 
+    uint16_t            gridHeight;
+    int32_t             level;
+    int32_t             lives;
+    int32_t             score;
+    uint32_t            numActors; // Not counting Peach, who is saved here 
+    int64_t             ticks;
+    uint64_t            seed;
+    uint64_t            randomState;
+    uint8_t             finalLevel;
+    uint8_t             peachAlive;
+    int16_t             peachDirection;
+    Peach::PowerState   peachPowers;
+    double              peachX;
+    double              peachY;
+};
+
+
+static const char SAVE_MAGIC[4] = { 'S', 'P', 'S', 'S' };
+static const uint32_t SAVE_VERSION = 2; // 1 also saved each Actor's spatial grid slot 
+static const uint32_t SAVE_BYTE_ORDER = 0x01020304;
+
+// Blocks and Pipes, the only kinds of Actor that are terrain 
+static bool terrainImage(int imageID)
+{
+    return imageID == IID_BLOCK || imageID == IID_PIPE;
+}
+
+// Only valid between init() and cleanUp(), when there is a Peach to save. Actors are saved as they are, dead ones included, since a tick 
+// that ends early (i.e. because Peach died) leaves them in place until the next one 
+void StudentWorld::saveState(vector<uint8_t>& out) const
+{
+    out.resize(sizeof(SaveHeader) + m_records.size() * sizeof(ActorRecord));
+    SaveHeader header;
+    fillHeader(header);
+    memcpy(out.data(), &header, sizeof(header));
+
+    // The records are kept up to date as the Actors change, so there is nothing to visit Actor by Actor here 
+    static_assert(sizeof(ActorRecord) == 24, "ActorRecords must have no padding");
+    if (!m_records.empty())
+        memcpy(out.data() + sizeof(SaveHeader), m_records.data(), m_records.size() * sizeof(ActorRecord));
+}
+
+void StudentWorld::fillHeader(SaveHeader& header) const
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAVE_MAGIC, sizeof(header.magic));
+    header.version = SAVE_VERSION;
+    header.byteOrder = SAVE_BYTE_ORDER;
+    header.gridWidth = GRID_WIDTH;
+    header.gridHeight = GRID_HEIGHT;
+    header.level = getLevel();
+    header.lives = getLives();
+    header.score = getScore();
+    header.numActors = m_records.size();
+    header.ticks = getTickCount();
+    header.seed = getSeed();
+    header.randomState = random().state();
+    header.finalLevel = m_finalLevel;
+    header.peachAlive = m_peach->alive();
+    header.peachDirection = m_peach->getDirection();
+    m_peach->getPowerState(header.peachPowers);
+    header.peachX = m_peach->getX();
+    header.peachY = m_peach->getY();
+}
+
+// Everything is checked before anything is touched, so a bad save state leaves the world as it was. A world whose terrain was rebuilt 
+// has no level template, so its next restartLevel() builds the level from scratch 
+bool StudentWorld::loadState(const uint8_t* data, size_t size)
+{
+    SaveHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SAVE_MAGIC, sizeof(header.magic)) != 0 || header.version != SAVE_VERSION || header.byteOrder != SAVE_BYTE_ORDER ||
+        header.gridWidth != GRID_WIDTH || header.gridHeight != GRID_HEIGHT ||
+        header.numActors != (size - sizeof(header)) / sizeof(ActorRecord) || (size - sizeof(header)) % sizeof(ActorRecord) != 0)
         return false;
 
-    // At this point, i points to a position in actor that overlaps VERTICALLY; since Actors is sorted vertically, all that needs to be checked is the horizontally overlapping of all 
-    // Actors relative to it (because it merely found the vertical matches with the binary search it is still possible that there could be vertical matches to the left or right of i)
-    int j = i;
-    // Check for left overlapping
-    while (j >= 0 && overlap(y, y + SPRITE_HEIGHT - 1, m_actors[j]->getY(), m_actors[j]->getY() + SPRITE_HEIGHT - 1, lower))
+    const uint8_t* records = data + sizeof(header);
+    for (size_t i = 0; i < header.numActors; i++)
+    {
+        ActorRecord record;
+        memcpy(&record, records + i * sizeof(ActorRecord), sizeof(record));
+        if (record.imageID == IID_PEACH || record.imageID >= NUM_IMAGE_IDS)
+            return false;
+    }
+
+    structureChanged();
+    // Terrain is most of a level, and never moves or dies, so if this world holds the same terrain already (i.e. it is a branch being 
+    // reset to a state it was cloned from before) its terrain Actors are kept, with just their goodies put back, and only the rest are 
+    // destroyed and created again 
+    bool keepTerrain = holdsTerrainOf(records, header.numActors);
+    if (keepTerrain)
     {
-        if (overlap(x, x + SPRITE_WIDTH - 1, m_actors[j]->getX(), m_actors[j]->getX() + SPRITE_WIDTH - 1, lower))
+        m_keptTerrain.clear();
+        for (size_t i = 0; i < m_actors.size(); i++)
         {
-            if (m_actors[j] != &actor)
+            if (m_actors[i]->terrain())
+                m_keptTerrain.push_back(m_actors[i]);
+            else
             {
-                m_actors[j]->bonk(actor);
-                bonked = true;
+                m_actorHash -= m_actors[i]->stateHash();
+                m_arena.destroy(m_actors[i]);
             }
         }
-        j--;
+        m_actors.clear();
+        m_records.clear();
+        if (m_peach != nullptr)
+        {
+            m_actorHash -= m_peach->stateHash();
+            m_arena.destroy(m_peach);
+        }
+        m_grid.clear();
+        m_numSpecialActors = 0;
     }
-    // Check for right overlapping
-    j = i + 1; // i + 1 since i was already checked 
-    while (j < m_actors.size() - m_numSpecialActors && overlap(y, y + SPRITE_HEIGHT - 1, m_actors[j]->getY(), m_actors[j]->getY() + SPRITE_HEIGHT - 1, lower))
+    else
+        cleanUp();
+    restoreHeader(header);
+
+    // The records are already in m_actors order, so they are simply appended. Which order the spatial grid holds them in doesn't matter, 
+    // since bonkAt() bonks in m_actors order whatever order it finds Actors in 
+    size_t nextTerrain = 0;
+    for (size_t i = 0; i < header.numActors; i++)
     {
-        if (overlap(x, x + SPRITE_WIDTH - 1, m_actors[j]->getX(), m_actors[j]->getX() + SPRITE_WIDTH - 1, lower))
+        ActorRecord record;
+        memcpy(&record, records + i * sizeof(ActorRecord), sizeof(record));
+        Actor* actor;
+        if (keepTerrain && terrainImage(record.imageID))
         {
-            if (m_actors[j] != &actor)
-            {
-                m_actors[j]->bonk(actor);
-                bonked = true;
-            }
+            actor = m_keptTerrain[nextTerrain++];
+            actor->setExtraState(record.extra);
+            actor->updateStateHash();
+        }
+        else
+        {
+            actor = restoreActor(record);
+            if (actor->terrain())
+                m_terrain.addTile(static_cast<int>(actor->getX()), static_cast<int>(actor->getY()));
         }
-        j++;
+        m_actors.push_back(actor);
+        if (actor->priority())
+            m_numSpecialActors++;
+        actor->setActorIndex(m_actors.size() - 1);
+        m_records.push_back(ActorRecord());
+        storeRecord(actor, m_records.back());
+        m_grid.insert(actor, actor->getX(), actor->getY());
     }
-    
-    return bonked;
+    return true;
+}
+
+void StudentWorld::restoreHeader(const SaveHeader& header)
+{
+    restoreProgress(header.level, header.lives, header.score, header.ticks);
+    setSeed(header.seed);
+    random().setState(header.randomState);
+    m_finalLevel = header.finalLevel != 0;
+
+    m_peach = m_arena.create<Peach>(this, static_cast<int>(header.peachX), static_cast<int>(header.peachY));
+    if (m_peach->getX() != header.peachX || m_peach->getY() != header.peachY)
+        m_peach->GraphObject::moveTo(header.peachX, header.peachY);
+    if (m_peach->getDirection() != header.peachDirection)
+        m_peach->setDirection(header.peachDirection);
+    m_peach->setPowerState(header.peachPowers);
+    m_peach->restoreAlive(header.peachAlive != 0);
+    m_peach->updateStateHash();
+}
+
+// Copy on write, in effect: while this world and other still hold the same Actors in the same order, and other has not changed since it 
+// was last cloned, an Actor this world has not changed is already a copy of other's, and only the ones it has changed (which it lists 
+// as it first changes each) need copying back. Peach and the progress are small, so they are always copied 
+void StudentWorld::cloneFrom(const StudentWorld& other)
+{
+    if (m_cloneSourceId == other.m_worldId && m_cloneVersion == other.m_version)
+    {
+        for (size_t i = 0; i < m_dirty.size(); i++)
+            restoreRecord(m_actors[m_dirty[i]], other.m_records[m_dirty[i]]);
+        for (size_t i = 0; i < m_dirty.size(); i++)
+            m_dirtyFlags[m_dirty[i]] = 0;
+        m_dirty.clear();
+
+        SaveHeader header;
+        other.fillHeader(header);
+        m_actorHash -= m_peach->stateHash();
+        m_arena.destroy(m_peach);
+        restoreHeader(header);
+        return;
+    }
+
+    other.saveState(m_cloneState);
+    loadState(m_cloneState.data(), m_cloneState.size());
+    m_cloneSourceId = other.m_worldId;
+    m_cloneVersion = other.m_version;
+    m_dirty.clear();
+    m_dirtyFlags.assign(m_records.size(), 0);
+}
+
+// The Actor is still flagged as changed while this runs, so putting it back does not list it again 
+void StudentWorld::restoreRecord(Actor* actor, const ActorRecord& record)
+{
+    if (actor->getX() != record.x || actor->getY() != record.y)
+        actor->moveTo(record.x, record.y);
+    if (actor->getDirection() != record.direction)
+        actor->setDirection(record.direction);
+    actor->setExtraState(record.extra);
+    actor->restoreAlive(record.alive != 0);
+    actor->updateStateHash();
+}
+
+// Whether m_actors holds exactly the terrain in a save state's records: the same Blocks and Pipes at the same places in the same order. 
+// Terrain is never reordered among itself in m_actors, so comparing in order is enough 
+bool StudentWorld::holdsTerrainOf(const uint8_t* records, size_t count) const
+{
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        ActorRecord record;
+        memcpy(&record, records + i * sizeof(ActorRecord), sizeof(record));
+        if (!terrainImage(record.imageID))
+            continue;
+        while (next < m_actors.size() && !m_actors[next]->terrain())
+            next++;
+        if (next == m_actors.size())
+            return false;
+        const Actor* actor = m_actors[next++];
+        if (actor->getID() != record.imageID || actor->getX() != record.x || actor->getY() != record.y || !record.alive)
+            return false;
+    }
+    for (; next < m_actors.size(); next++)
+        if (m_actors[next]->terrain())
+            return false;
+    return true;
+}
+
+Actor* StudentWorld::restoreActor(const ActorRecord& record)
+{
+    int x = static_cast<int>(record.x);
+    int y = static_cast<int>(record.y);
+    int dir = record.direction;
+    Actor* actor;
+    switch (record.imageID)
+    {
+    case IID_BLOCK:
+        actor = m_arena.create<Block>(this, x, y, 0);
+        break;
+    case IID_PIPE:
+        actor = m_arena.create<Pipe>(this, x, y);
+        break;
+    case IID_FLAG:
+        actor = m_arena.create<Flag>(this, x, y);
+        break;
+    case IID_MARIO:
+        actor = m_arena.create<Mario>(this, x, y);
+        break;
+    case IID_MUSHROOM:
+        actor = m_arena.create<Mushroom>(this, x, y);
+        break;
+    case IID_FLOWER:
+        actor = m_arena.create<Flower>(this, x, y);
+        break;
+    case IID_STAR:
+        actor = m_arena.create<Star>(this, x, y);
+        break;
+    case IID_PIRANHA_FIRE:
+        actor = m_arena.create<PiranhaFireball>(this, x, y, dir);
+        break;
+    case IID_PEACH_FIRE:
+        actor = m_arena.create<PeachFireball>(this, x, y, dir);
+        break;
+    case IID_SHELL:
+        actor = m_arena.create<Shell>(this, x, y, dir);
+        break;
+    case IID_GOOMBA:
+        actor = m_arena.create<Goomba>(this, x, y, dir);
+        break;
+    case IID_KOOPA:
+        actor = m_arena.create<Koopa>(this, x, y, dir);
+        break;
+    default: // IID_PIRANHA; loadState() has already rejected anything else 
+        actor = m_arena.create<Piranha>(this, x, y, dir);
+        break;
+    }
+    // Positions are whole pixels in practice, but a fractional one is put back exactly; this bypasses Actor::moveTo() since the Actor is 
+    // not in the spatial grid yet 
+    if (actor->getX() != record.x || actor->getY() != record.y)
+        actor->GraphObject::moveTo(record.x, record.y);
+    if (actor->getDirection() != dir)
+        actor->setDirection(dir);
+    actor->setExtraState(record.extra);
+    actor->restoreAlive(record.alive != 0);
+    actor->updateStateHash();
+    return actor;
+}
+
+// The Actors' part of the hash is kept up to date as they change; the rest of the world's state is only a few numbers, so it is simply 
+// mixed in here 
+uint64_t StudentWorld::stateHash() const
+{
+    return m_actorHash + progressHash();
+}
+
+uint64_t StudentWorld::recomputeStateHash() const
+{
+    uint64_t h = progressHash();
+    for (size_t i = 0; i < m_actors.size(); i++)
+        h += m_actors[i]->computeStateHash();
+    if (m_peach != nullptr)
+        h += m_peach->computeStateHash();
+    return h;
+}
+
+uint64_t StudentWorld::progressHash() const
+{
+    uint64_t h = Random::mix(static_cast<uint32_t>(getScore()));
+    h = Random::mix(h ^ static_cast<uint32_t>(getLives()));
+    h = Random::mix(h ^ static_cast<uint32_t>(getLevel()));
+    h = Random::mix(h ^ (m_finalLevel ? 1 : 0));
+    return Random::mix(h ^ random().state());
 }
 
 void StudentWorld::givePowerup(int powerup)
@@ -324,75 +822,27 @@ bool StudentWorld::overlap(double start1, double end1, double start2, double end
     return false;
 }
 
-// Standard binary search algorithm, using the overlap() method to determine which half to search 
-int StudentWorld::actorBinarySearch(double y, const vector<Actor*>& actors, int start, int end) const
+bool StudentWorld::overlapsActor(double x, double y, const Actor& actor) const
 {
-    if (start <= end)
-    {
-        bool lower;
-        int mid = start + (end - start) / 2;
-        if (overlap(y, y + SPRITE_HEIGHT - 1, m_actors[mid]->getY(), m_actors[mid]->getY() + SPRITE_HEIGHT - 1, lower))
-            return mid;
-        else if (lower)
-            return actorBinarySearch(y, actors, start, mid - 1);
-        else
-            return actorBinarySearch(y, actors, mid + 1, end);
-    }
-    return -1;
+    bool lower;
+    return overlap(x, x + SPRITE_WIDTH - 1, actor.getX(), actor.getX() + SPRITE_WIDTH - 1, lower) && overlap(y, y + SPRITE_HEIGHT - 1, actor.getY(), actor.getY() + SPRITE_HEIGHT - 1, lower);
 }
 
-// Same algorithm as bonkAt(), however special actors are not iterated through since they (Goodies, Fireballs, Shells) are guaranteed to never 
-// block or be damageable
+// Only the Actors in the grid cells around (x, y) need to be checked. Special actors (Goodies, Fireballs, Shells) are guaranteed to never 
+// block or be damageable, so they are skipped 
 bool StudentWorld::blockOrDamageAt(double x, double y, bool block) const
 {
-    bool lower;
-    int i = 0;
-
-    // Use binary search based on vertical position to find the actor blocking 
-    i = actorBinarySearch(y, m_actors, i, m_actors.size() - m_numSpecialActors);
-    if (i == -1) // No vertical matches 
-        return false;
+    return m_grid.any(x, y, [&](const Actor* a) {
+        if (a->priority() || !overlapsActor(x, y, *a))
+            return false;
+        if (block)
+            return a->terrain();
+        return !a->friendly() && !a->projectile() && a->alive();
+    });
+}
 
-    // At this point, i points to a position in actor that overlaps VERTICALLY; since Actors is sorted vertically, all that needs to be checked is the horizontally overlapping of all 
-    // Actors relative to it (because it merely found the vertical matches with the binary search it is still possible that there could be vertical matches to the left or right of i)
-    int j = i;
-    // Check for left overlapping
-    while (j >= 0 && overlap(y, y + SPRITE_HEIGHT - 1, m_actors[j]->getY(), m_actors[j]->getY() + SPRITE_HEIGHT - 1, lower))
-    {
-        if (overlap(x, x + SPRITE_WIDTH - 1, m_actors[j]->getX(), m_actors[j]->getX() + SPRITE_WIDTH - 1, lower))
-        {
-            if (block)
-            {
-                if (m_actors[j]->terrain())
-                    return true;
-            }
-            else
-            {
-                if (!m_actors[j]->friendly() && !m_actors[j]->projectile() && m_actors[j]->alive())
-                    return true;
-            }
-        }
-        j--;
-    }
-    // Check for right overlapping
-    j = i + 1;
-    while (j < m_actors.size() - m_numSpecialActors && overlap(y, y + SPRITE_HEIGHT - 1, m_actors[j]->getY(), m_actors[j]->getY() + SPRITE_HEIGHT - 1, lower))
-    {
-        if (overlap(x, x + SPRITE_WIDTH - 1, m_actors[j]->getX(), m_actors[j]->getX() + SPRITE_WIDTH - 1, lower))
-        {
-            if (block)
-            {
-                if (m_actors[j]->terrain())
-                    return true;
-            }
-            else
-            {
-                if (!m_actors[j]->friendly() && !m_actors[j]->projectile() && m_actors[j]->alive())
-                    return true;
-            }
-        }
-        j++;
-    }
-    // No overlapping found
-    return false;
-}
\ No newline at end of file
+void StudentWorld::actorMoved(Actor* actor, double oldX, double oldY)
+{
+    // Peach is not part of m_actors, so the grid will simply not find her and leave the grid unchanged 
+    m_grid.move(actor, oldX, oldY, actor->getX(), actor->getY());
+}
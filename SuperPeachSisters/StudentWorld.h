@@ -3,12 +3,19 @@
 
 #include "GameWorld.h"
 #include "Level.h"
+#include "CompiledLevel.h"
+#include "SpatialGrid.h"
+#include "TerrainMap.h"
+#include "ActorArena.h"
 #include <vector>
 #include <string>
+#include <map>
+#include <memory>
 using namespace std;
 
 class Actor;
 class Peach;
+class Block;
 
 class StudentWorld : public GameWorld
 {
@@ -18,7 +25,15 @@ class StudentWorld : public GameWorld
 		virtual int init();
 		virtual int move();
 		virtual void cleanUp();
-		void addActor(Actor* actor); // Insert Actor into appropriate position in actors Vector 
+		virtual int restartLevel();
+		// Construct an Actor of type T from the world's arena and insert it into the appropriate position in the actors Vector 
+		template <typename T, typename... Args>
+		T* addActor(Args... args)
+		{
+			T* actor = m_arena.create<T>(this, args...);
+			insertActor(actor);
+			return actor;
+		}
 		bool isBlockingAt(double x, double y) const; // Check if an Actor capable of blocking is at the specified position 
 		bool isDamageableAt(double x, double y) const; // Check if an Actor capable of being damaged (NOT PEACH) is at the specified position 
 		bool isPlayerAt(double x, double y, const Actor& actor, bool bonk); // Check if Peach is at the specified position; pass true to the final parameter to also bonk Peach
@@ -26,16 +41,137 @@ class StudentWorld : public GameWorld
 		void getPlayerLocation(double& x, double& y) const; //  Get Location of Peach 
 		void givePowerup(int powerup); // Give Peach a Powerup
 		void setFinalLevel() { m_finalLevel = true; } // Indicate that the current level is the final level
+		void actorMoved(Actor* actor, double oldX, double oldY); // Keep the spatial grid up to date whenever an Actor moves 
+		const ActorArena& arena() const { return m_arena; } // Allocation statistics, i.e. to confirm that spawning Actors no longer allocates 
+
+		// The following are for tools (benchmarks, level QA) rather than for the game itself 
+		// Load this file (relative to the asset path) instead of levelNN.txt. The level in play no longer matches it, so the next 
+		// restartLevel() builds the new one from scratch rather than reusing the old one's template 
+		void setLevelFile(std::string filename) { m_levelFile = filename; m_levels.clear(); m_template.level = nullptr; }
+		int numActors() const { return m_actors.size() + (m_peach != nullptr ? 1 : 0); } // Number of Actors currently in the world, including Peach 
+		void countActorsByImage(vector<int>& counts) const; // counts[imageID] = number of Actors with that image, including Peach 
+
+		// Save states: the whole world (every Actor, Peach, the score, lives, level, tick count and random number state) as a compact, 
+		// versioned binary blob, and back. Saving reuses out's storage, so saving into the same vector every tick does not allocate; the Actors themselves are one memcpy of m_records 
+		void saveState(vector<uint8_t>& out) const;
+		bool loadState(const uint8_t* data, size_t size); // Returns false, leaving the world untouched, if data is not a save state this build can read 
+
+		// Branching search: make this world a copy of other (which must have a level loaded), e.g. to try one move after another from the 
+		// same state. The first clone loads a save state of other. After that, as long as neither world has added or removed an Actor and 
+		// other has not changed, cloning from other again only copies back the Actors this world has changed since, and Peach; the rest 
+		// are left as they are. Actors themselves are never shared between worlds, since each holds its own world's grid slot and index 
+		void cloneFrom(const StudentWorld& other);
+
+		// A 64-bit hash of the whole world state, to tell states apart in a search or to compare replays tick by tick. It is an additive 
+		// multiset hash: the (wrapping) sum of every Actor's own hash, which is kept up to date by subtracting an Actor's old hash and adding 
+		// its new one whenever it changes (see Actor::updateStateHash()), so reading it is O(1). Being a sum, it ignores which slot of 
+		// m_actors holds which Actor, so swapping the states of two Actors of the same kind gives the same hash 
+		virtual uint64_t stateHash() const;
+		uint64_t recomputeStateHash() const; // The same hash computed from scratch, to check the incremental one 
+
+		// For Actor::updateStateHash(), which is called whenever anything about an Actor that is hashed or saved changes: keep the world's 
+		// hash and the Actor's record up to date 
+		void actorChanged(const Actor* actor, uint64_t hashChange)
+		{
+			m_actorHash += hashChange;
+			size_t index = actor->actorIndex(); // -1 (i.e. Peach, or an Actor not added yet) becomes too large to be an index 
+			if (index < m_records.size())
+			{
+				storeRecord(actor, m_records[index]);
+				m_version++;
+				if (m_cloneSourceId != 0 && !m_dirtyFlags[index]) // The first change since this world was cloned 
+				{
+					m_dirtyFlags[index] = 1;
+					m_dirty.push_back(index);
+				}
+			}
+		}
 
 	private:
+		ActorArena m_arena; // Declared first so that it outlives every Actor allocated from it 
 		Peach* m_peach;
 		vector<Actor*> m_actors; // Using a vector since access will be more common than insertion
 		int m_numSpecialActors; // Number of prioritized actors that are at the end of the m_actors vector 
 		bool m_finalLevel;
+		bool m_bulkLoading; // Set while init() is populating m_actors, which it sorts once when done 
+		string m_levelFile; // If not empty, the level file to load in place of levelNN.txt 
+		map<int, unique_ptr<CompiledLevel>> m_levels; // Every level loaded so far, by level number 
+
+		// How init() built the current level, so restartLevel() can put it back without building its terrain again 
+		struct LevelTemplate
+		{
+			const CompiledLevel* level; // nullptr if there is nothing to restart from, i.e. after cleanUp() 
+			int levelNumber;
+			vector<unsigned> order; // The spawn index of each Actor in m_actors as init() left it 
+			vector<unsigned> respawns; // Spawn indices of everything but terrain, Peach included, in spawn order 
+			vector<pair<Block*, int>> goodieBlocks; // Blocks that start with a goodie, and which goodie 
+		};
+		LevelTemplate m_template;
+		vector<Actor*> m_spawned; // The Actor most recently created for each entry of the level's spawn list 
+		SpatialGrid m_grid; // Buckets every Actor in m_actors by position so that queries only look at nearby Actors 
+		TerrainMap m_terrain; // Precomputed blocking bitmap for Blocks and Pipes, which never move once added 
+		vector<Actor*> m_nearby; // Scratch buffer for bonkAt(), kept as a member so its capacity is reused across calls 
+		vector<pair<size_t, Actor*>> m_hits; // Scratch buffer for bonkAt(): the Actors it bonks, with their place in bonking order 
+		vector<Actor*> m_keptTerrain; // Scratch buffer for loadState(), for the terrain Actors it keeps 
+		vector<uint8_t> m_cloneState; // Buffer for cloneFrom(), kept so that cloning does not allocate 
+		uint64_t m_worldId; // Tells worlds apart for cloneFrom(); unlike an address, it is never reused by a later world 
+		uint64_t m_version; // Changes whenever an Actor in m_actors, or m_actors itself, does 
+		uint64_t m_cloneSourceId; // The world this one was last cloned from, or 0 if either has added or removed an Actor since 
+		uint64_t m_cloneVersion; // That world's m_version when this one was cloned from it 
+		vector<size_t> m_dirty; // Indices of the Actors in m_actors this world has changed since it was cloned, each listed once 
+		vector<uint8_t> m_dirtyFlags; // m_dirtyFlags[i] is set if i is in m_dirty 
+		uint64_t m_actorHash; // Sum (wrapping) of the stateHash() of every Actor in the world, Peach included 
+		string m_statusText; // The status line last given to the host, and what it was built from 
+		bool m_statusShown;
+		int m_statusLives;
+		int m_statusLevel;
+		int m_statusScore;
+		int m_statusPowers;
+
+		// One Actor's state as a save state stores it. Every field has a fixed size and there is no padding, so the same state is always the 
+		// same bytes 
+		struct ActorRecord
+		{
+			double		x;
+			double		y;
+			int32_t		extra; // Actor::extraState() 
+			int16_t		direction;
+			uint8_t		imageID; // Every kind of Actor has its own image, so this says which kind to create 
+			uint8_t		alive;
+		};
+		vector<ActorRecord> m_records; // m_records[i] is the state of m_actors[i], so that saving the Actors is a single copy 
+
+		static void storeRecord(const Actor* actor, ActorRecord& record)
+		{
+			record.x = actor->getX();
+			record.y = actor->getY();
+			record.extra = actor->extraState();
+			record.direction = actor->getDirection();
+			record.imageID = actor->getID();
+			record.alive = actor->alive();
+		}
+
+		struct SaveHeader;
+		void fillHeader(SaveHeader& header) const; // Everything a save state holds besides the Actors in m_actors 
+		void restoreHeader(const SaveHeader& header); // Put back the progress and Peach a save state holds; the old Peach must be gone 
+		void restoreRecord(Actor* actor, const ActorRecord& record); // Put an Actor of the same kind back in the state a record holds 
+
+		// Call whenever an Actor is added to or removed from m_actors: cloning from this world, or into it, can no longer just copy Actors 
+		// back by index 
+		void structureChanged() { m_version++; m_cloneSourceId = 0; }
 
 		bool overlap(double start1, double end1, double start2, double end2, bool& lower) const; // Overlap auxiliary method 
-		int actorBinarySearch(double y, const vector<Actor*>& actors, int start, int end) const;
+		bool overlapsActor(double x, double y, const Actor& actor) const; // Check if a sprite at (x, y) overlaps the given Actor 
 		bool blockOrDamageAt(double x, double y, bool block) const;
+		void insertActor(Actor* actor); // Insert an already constructed Actor into m_actors and the spatial structures 
+		void removeDeadActors(); // Destroy all dead Actors and compact m_actors in a single pass 
+		size_t bonkRank(const Actor* actor) const; // Position of an Actor in the order bonkAt() bonks Actors in 
+		void updateStatusText(); // Give the host a new status line if anything on it has changed 
+		const CompiledLevel* loadLevel(int level); // Load a level, or find it already loaded 
+		Actor* spawnActor(const CompiledLevel::Spawn& spawn); // Create the Actor for an entry of a level's spawn list 
+		Actor* restoreActor(const ActorRecord& record); // Create an Actor as a save state recorded it 
+		bool holdsTerrainOf(const uint8_t* records, size_t count) const; // Whether m_actors has the same terrain as a save state's records 
+		uint64_t progressHash() const; // Hash of everything in the world's state besides its Actors 
 
 };
 
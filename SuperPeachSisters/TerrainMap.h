@@ -0,0 +1,93 @@
+#ifndef TERRAINMAP_H_
+#define TERRAINMAP_H_
+
+#include "GameConstants.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// Pixel-resolution bitmap of where terrain (Blocks and Pipes) blocks a sprite. Rather than storing the pixels the terrain covers, bit (x, y) is
+// set if a sprite whose lower-left corner is at (x, y) would overlap any terrain tile, so a blocking check is a single bit test. The bitmap has
+// a margin of SPRITE_WIDTH - 1 (SPRITE_HEIGHT - 1) pixels on the low edges since a sprite slightly off the board can still overlap a tile at 0
+class TerrainMap
+{
+	public:
+		TerrainMap(int width = VIEW_WIDTH, int height = VIEW_HEIGHT)
+		 : m_width(width + MARGIN_X), m_height(height + MARGIN_Y), m_wordsPerRow((m_width + 63) / 64),
+		   m_bits(m_wordsPerRow * m_height, 0)
+		{
+		}
+
+		void clear()
+		{
+			std::fill(m_bits.begin(), m_bits.end(), 0);
+		}
+
+		// Mark a SPRITE_WIDTH x SPRITE_HEIGHT terrain tile with its lower-left corner at (x, y)
+		void addTile(int x, int y)
+		{
+			// Any sprite with its corner within SPRITE_WIDTH - 1 (SPRITE_HEIGHT - 1) of the tile's corner overlaps it
+			for (int row = y - MARGIN_Y; row <= y + MARGIN_Y; row++)
+				setRun(row, x - MARGIN_X, x + MARGIN_X);
+		}
+
+		// Mark a row of adjacent tiles at once, with the lower-left corners of the first and last at (x0, y) and (x1, y)
+		void addSpan(int x0, int x1, int y)
+		{
+			for (int row = y - MARGIN_Y; row <= y + MARGIN_Y; row++)
+				setRun(row, x0 - MARGIN_X, x1 + MARGIN_X);
+		}
+
+		// The raw bitmap, e.g. to save it in a compiled level, and a way to load one saved from a map of the same size
+		const std::vector<uint64_t>& words() const
+		{
+			return m_bits;
+		}
+
+		bool assign(const uint64_t* words, size_t count)
+		{
+			if (count != m_bits.size())
+				return false;
+			std::copy(words, words + count, m_bits.begin());
+			return true;
+		}
+
+		bool blockingAt(int x, int y) const
+		{
+			int col = x + MARGIN_X;
+			int row = y + MARGIN_Y;
+			if (col < 0 || col >= m_width || row < 0 || row >= m_height) // Too far off the board to overlap anything
+				return false;
+			return (m_bits[row * m_wordsPerRow + col / 64] >> (col % 64)) & 1;
+		}
+
+	private:
+		static const int MARGIN_X = SPRITE_WIDTH - 1;
+		static const int MARGIN_Y = SPRITE_HEIGHT - 1;
+
+		int m_width;
+		int m_height;
+		int m_wordsPerRow;
+		std::vector<uint64_t> m_bits; // Row-major, bit (col % 64) of word [row * m_wordsPerRow + col / 64]
+
+		// Set bits [x0, x1] of the given row (in board coordinates), a word at a time
+		void setRun(int y, int x0, int x1)
+		{
+			int row = y + MARGIN_Y;
+			if (row < 0 || row >= m_height)
+				return;
+			int first = std::max(x0 + MARGIN_X, 0);
+			int last = std::min(x1 + MARGIN_X, m_width - 1);
+			uint64_t* words = &m_bits[row * m_wordsPerRow];
+			while (first <= last)
+			{
+				int bit = first % 64;
+				int count = std::min(64 - bit, last - first + 1);
+				uint64_t mask = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+				words[first / 64] |= mask;
+				first += count;
+			}
+		}
+};
+
+#endif // TERRAINMAP_H_
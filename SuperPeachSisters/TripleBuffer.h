@@ -0,0 +1,65 @@
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+#include <atomic>
+
+// Hands values from one producer thread to one consumer thread without locks. The producer fills writeBuffer() and publish()es it; the
+// consumer calls update() whenever it wants the newest published value, then reads readBuffer() for as long as it likes. Of the three
+// buffers, one is always the producer's, one the consumer's, and the third holds whatever was published last, so neither side ever
+// waits for the other: a producer that is faster than the consumer simply overwrites values nobody will see. Buffers are reused, so a
+// T that holds containers stops allocating once they have grown to size
+template<typename T>
+class TripleBuffer
+{
+	public:
+		TripleBuffer()
+		 : m_middle(1), m_write(0), m_read(2)
+		{
+		}
+
+		  // Producer side
+		T& writeBuffer()
+		{
+			return m_buffers[m_write];
+		}
+
+		void publish()
+		{
+			m_write = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel) & INDEX;
+		}
+
+		  // Consumer side. True if something newer than the current read buffer has been published
+		bool pending() const
+		{
+			return (m_middle.load(std::memory_order_relaxed) & FRESH) != 0;
+		}
+
+		  // Take the newest published value as the read buffer, if there is one, and return whether there was
+		bool update()
+		{
+			if (!pending())
+				return false;
+			m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & INDEX;
+			return true;
+		}
+
+		const T& readBuffer() const
+		{
+			return m_buffers[m_read];
+		}
+
+	private:
+		static const unsigned INDEX = 3;
+		static const unsigned FRESH = 4;	// Set in m_middle from publish() until the consumer takes it
+
+		T m_buffers[3];
+		std::atomic<unsigned> m_middle;
+		unsigned m_write;	// Only touched by the producer
+		unsigned m_read;	// Only touched by the consumer
+
+		  // Prevent copying or assigning TripleBuffers
+		TripleBuffer(const TripleBuffer&);
+		TripleBuffer& operator=(const TripleBuffer&);
+};
+
+#endif // TRIPLEBUFFER_H_
@@ -0,0 +1,75 @@
+#ifndef WORLDSNAPSHOT_H_
+#define WORLDSNAPSHOT_H_
+
+#include "GraphObject.h"
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Everything needed to draw one tick of a world, copied out of its GraphObject registry so it can be drawn without touching the world
+// itself, e.g. on another thread while the world runs its next tick. Sprites are kept by depth along with that depth's registry version.
+// capture() only copies the depths whose version has changed since this snapshot last captured them, so refreshing a snapshot mostly
+// costs as much as what moved
+struct WorldSnapshot
+{
+	struct Sprite
+	{
+		int		imageID;
+		int		frame;		// The object's animation number; the renderer knows how many frames the image really has
+		float	x;
+		float	y;
+		float	startX;		// Where the object was at the start of the tick, to draw it moving from there to (x, y)
+		float	startY;
+		short	direction;
+		float	size;
+	};
+
+	struct Layer
+	{
+		Layer()
+		 : captured(false), version(0), settled(false)
+		{
+		}
+
+		std::vector<Sprite> sprites;	// Visible objects only, in drawing order
+		bool			captured;
+		unsigned long	version;
+		bool			settled;		// Nothing here moved during the tick, so startX/startY are the same as x/y
+	};
+
+	Layer		layers[GraphObjectRegistry::NUM_DEPTHS];
+	std::string	statText;
+	std::chrono::steady_clock::time_point capturedAt;
+
+	void capture(const GraphObjectRegistry& registry, const std::string& gameStatText)
+	{
+		for (int depth = 0; depth < GraphObjectRegistry::NUM_DEPTHS; depth++)
+		{
+			const GraphObjectRegistry::Layer& objects = registry.objects(depth);
+			Layer& layer = layers[depth];
+			if (layer.captured && layer.settled && layer.version == objects.version())
+				continue;
+
+			layer.sprites.clear();
+			for (auto it = objects.begin(); it != objects.end(); it++)
+			{
+				GraphObject* obj = *it;
+				if (!obj->isVisible())
+					continue;
+				double startX, startY;
+				obj->getTickStartLocation(startX, startY);
+				Sprite s = { obj->getID(), obj->getAnimationNumber(), static_cast<float>(obj->getX()), static_cast<float>(obj->getY()),
+							 static_cast<float>(startX), static_cast<float>(startY), static_cast<short>(obj->getDirection()),
+							 static_cast<float>(obj->getSize()) };
+				layer.sprites.push_back(s);
+			}
+			layer.captured = true;
+			layer.version = objects.version();
+			layer.settled = registry.settled(depth);
+		}
+		statText = gameStatText;
+		capturedAt = std::chrono::steady_clock::now();
+	}
+};
+
+#endif // WORLDSNAPSHOT_H_
@@ -54,5 +54,6 @@ int main(int argc, char* argv[])
 	}
 
 	GameWorld* gw = createStudentWorld(assetPath);
-	Game().run(argc, argv, gw, "Super Peach Sisters");
+	GameController controller;
+	controller.run(argc, argv, gw, "Super Peach Sisters");
 }